@@ -0,0 +1,52 @@
+// vim: expandtab:ts=2:sw=2
+/*
+ * Copyright (c) 2025 Seiden Group
+ *
+ * SPDX-License-Identifier: ISC
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+/*
+ * Shared timing and reporting for the benchmarks.
+ */
+
+// Keep the compiler from optimizing away a value that isn't otherwise used
+template <typename T> inline void do_not_optimize(const T &value) {
+  asm volatile("" : : "m"(value) : "memory");
+}
+
+template <typename F> double time_ns(size_t iterations, F f) {
+  auto begin = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; i++) {
+    f();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - begin).count() /
+         iterations;
+}
+
+/*
+ * Print the time per operation; if threshold_ns isn't 0, also check it
+ * against that, returning false if it's slower. Thresholds are generous,
+ * to catch regressions and not noise; for slow machines, they can be
+ * multiplied by setting BENCH_THRESHOLD_SCALE.
+ */
+inline bool report_ns(const char *name, double ns, double threshold_ns = 0) {
+  static const double scale = []() {
+    const char *env = getenv("BENCH_THRESHOLD_SCALE");
+    return env != nullptr ? atof(env) : 1.0;
+  }();
+  if (threshold_ns == 0) {
+    printf("%-28s %12.1f ns\n", name, ns);
+    return true;
+  }
+  bool ok = ns <= threshold_ns * scale;
+  printf("%-28s %12.1f ns (limit %.0f)%s\n", name, ns, threshold_ns * scale,
+         ok ? "" : " REGRESSION");
+  return ok;
+}
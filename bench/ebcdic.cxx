@@ -0,0 +1,312 @@
+// vim: expandtab:ts=2:sw=2
+/*
+ * Copyright (c) 2025 Seiden Group
+ *
+ * SPDX-License-Identifier: ISC
+ */
+
+/*
+ * Compares the runtime EBCDIC transcoding in ebcdic.hxx against glibc iconv
+ * for CCSID 37. Linux only; on PASE, iconv is libiconv and not comparable.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <iconv.h>
+
+#include "ebcdic.hxx"
+
+#include "bench.hxx"
+
+using namespace pase_cpp;
+
+static const size_t bulk_size = 1024 * 1024;
+static const size_t field_width = 10;
+static const size_t field_count = 100000;
+
+// Keep the compiler from throwing away the work
+static volatile unsigned char sink;
+
+static void report(const char *name, double ns, size_t bytes) {
+  printf("%-28s %12.1f ns %10.1f MB/s\n", name, ns, bytes / ns * 1000.0);
+}
+
+// Known names to dispatch on, like a tool looking for some system values
+static const char *const sysval_names[] = {
+    "QCCSID",   "QDATE",    "QTIME",    "QDATFMT",  "QDATSEP",  "QTIMSEP",
+    "QDECFMT",  "QCURSYM",  "QLANGID",  "QCNTRYID", "QSYSLIBL", "QUSRLIBL",
+    "QSECURITY", "QMODEL",  "QSRLNBR",  "QTIMZON"};
+static const size_t sysval_count =
+    sizeof(sysval_names) / sizeof(sysval_names[0]);
+
+static constexpr auto sysval_set = ebcdic_names<field_width>(
+    "QCCSID", "QDATE", "QTIME", "QDATFMT", "QDATSEP", "QTIMSEP", "QDECFMT",
+    "QCURSYM", "QLANGID", "QCNTRYID", "QSYSLIBL", "QUSRLIBL", "QSECURITY",
+    "QMODEL", "QSRLNBR", "QTIMZON");
+static_assert(sysval_set.index("QTIMZON") == 15, "index at compile time");
+
+// Every system value, for a set the size of a real one
+static constexpr const char *all_sysval_names[] = {
+    "QABNORMSW", "QACGLVL", "QACTJOB", "QADLACTJ", "QADLSPLA", "QADLTOTJ",
+    "QALWJOBITP", "QALWOBJRST", "QALWUSRDMN", "QASTLVL", "QATNPGM", "QAUDCTL",
+    "QAUDENDACN", "QAUDFRCLVL", "QAUDLVL", "QAUDLVL2", "QAUTOCFG", "QAUTORMT",
+    "QAUTOSPRPT", "QAUTOVRT", "QBASACTLVL", "QBASPOOL", "QBOOKPATH", "QCCSID",
+    "QCENTURY", "QCFGMSGQ", "QCHRID", "QCHRIDCTL", "QCMNARB", "QCMNRCYLMT",
+    "QCNTRYID", "QCONSOLE", "QCRTAUT", "QCRTOBJAUD", "QCTLSBSD", "QCURSYM",
+    "QDATE", "QDATETIME", "QDATFMT", "QDATSEP", "QDAY", "QDAYOFWEEK",
+    "QDBFSTCCOL", "QDBRCVYWT", "QDECFMT", "QDEVNAMING", "QDEVRCYACN",
+    "QDSCJOBITV", "QDSPSGNINF", "QDYNPTYADJ", "QDYNPTYSCD", "QENDJOBLMT",
+    "QFRCCVNRST", "QHOUR", "QHSTLOGSIZ", "QIGC", "QIGCCDEFNT", "QIGCFNTSIZ",
+    "QINACTITV", "QINACTMSGQ", "QIPLDATTIM", "QIPLSTS", "QIPLTYPE",
+    "QJOBMSGQFL", "QJOBMSGQMX", "QJOBMSGQSZ", "QJOBMSGQTL", "QJOBSPLA",
+    "QKBDBUF", "QKBDTYPE", "QLANGID", "QLEAPADJ", "QLIBLCKLVL", "QLMTDEVSSN",
+    "QLMTSECOFR", "QLOCALE", "QLOGOUTPUT", "QMAXACTLVL", "QMAXJOB",
+    "QMAXSGNACN", "QMAXSIGN", "QMAXSPLF", "QMCHPOOL", "QMINUTE", "QMLTTHDACN",
+    "QMODEL", "QMONTH", "QPASTHRSVR", "QPFRADJ", "QPRBFTR", "QPRBHLDITV",
+    "QPRCFEAT", "QPRCMLTTSK", "QPRTDEV", "QPRTKEYFMT", "QPRTTXT", "QPWDCHGBLK",
+    "QPWDEXPITV", "QPWDEXPWRN", "QPWDLMTAJC", "QPWDLMTCHR", "QPWDLMTREP",
+    "QPWDLVL", "QPWDMAXLEN", "QPWDMINLEN", "QPWDPOSDIF", "QPWDRQDDGT",
+    "QPWDRQDDIF", "QPWDRULES", "QPWDVLDPGM", "QPWRDWNLMT", "QPWRRSTIPL",
+    "QQRYDEGREE", "QQRYTIMLMT", "QRCLSPLSTG", "QRETSVRSEC", "QRMTIPL",
+    "QRMTSIGN", "QRMTSRVATR", "QSAVACCPTH", "QSCANFS", "QSCANFSCTL",
+    "QSCPFCONS", "QSECOND", "QSECURITY", "QSETJOBATR", "QSFWERRLOG",
+    "QSHRMEMCTL", "QSPCENV", "QSPLFACN", "QSRLNBR", "QSRTSEQ", "QSRVDMP",
+    "QSSLCSL", "QSSLCSLCTL", "QSSLPCL", "QSTGLOWACN", "QSTGLOWLMT",
+    "QSTRPRTWTR", "QSTRUPPGM", "QSTSMSG", "QSVRAUTITV", "QSYSLIBL",
+    "QTHDRSCADJ", "QTHDRSCAFN", "QTIMADJ", "QTIME", "QTIMSEP", "QTIMZON",
+    "QTOTJOB", "QTSEPOOL", "QUPSDLYTIM", "QUPSMSGQ", "QUSEADPAUT", "QUSRLIBL",
+    "QUTCOFFSET", "QVFYOBJRST", "QYEAR",
+};
+static constexpr size_t all_sysval_count =
+    sizeof(all_sysval_names) / sizeof(all_sysval_names[0]);
+static constexpr EbcdicNameSet<field_width, all_sysval_count> all_sysval_set(
+    all_sysval_names);
+static_assert(all_sysval_set.index("QYEAR") == all_sysval_count - 1,
+              "index at compile time");
+
+static void iconv_all(iconv_t cd, char *dst, const char *src, size_t len) {
+  char *in = (char *)src, *out = dst;
+  size_t inleft = len, outleft = len;
+  iconv(cd, &in, &inleft, &out, &outleft);
+}
+
+int main(void) {
+  iconv_t from_37 = iconv_open("ISO-8859-1", "IBM037");
+  if (from_37 == (iconv_t)-1) {
+    perror("iconv_open");
+    return 1;
+  }
+
+  iconv_t to_37 = iconv_open("IBM037", "ISO-8859-1");
+  if (to_37 == (iconv_t)-1) {
+    perror("iconv_open");
+    return 1;
+  }
+
+  // Every byte value, both ways, against iconv
+  char all[256], all_e[256], all_a[256], expected_e[256], expected_a[256];
+  for (int i = 0; i < 256; i++) {
+    all[i] = (char)i;
+  }
+  a2e(all_e, all, 256);
+  iconv_all(to_37, expected_e, all, 256);
+  e2a(all_a, all, 256);
+  iconv_all(from_37, expected_a, all, 256);
+  for (int i = 0; i < 256; i++) {
+    if (all_e[i] != expected_e[i] || all_a[i] != expected_a[i]) {
+      fprintf(stderr, "0x%02X: mismatch with iconv\n", i);
+      return 1;
+    }
+  }
+  e2a(all_a, all_e, 256);
+  if (memcmp(all_a, all, 256) != 0) {
+    fprintf(stderr, "a2e then e2a doesn't round trip\n");
+    return 1;
+  }
+
+  std::vector<char> ascii(bulk_size), ebcdic(bulk_size), out(bulk_size),
+      expected(bulk_size);
+  srand(37);
+  for (size_t i = 0; i < bulk_size; i++) {
+    ascii[i] = (char)(rand() % 256);
+  }
+  a2e(ebcdic.data(), ascii.data(), bulk_size);
+  iconv_all(from_37, expected.data(), ebcdic.data(), bulk_size);
+
+  printf("bulk: %zu bytes\n", bulk_size);
+  e2a(out.data(), ebcdic.data(), bulk_size);
+  if (out != expected) {
+    fprintf(stderr, "e2a: mismatch with iconv\n");
+    return 1;
+  }
+  report("e2a", time_ns(100, [&]() {
+           e2a(out.data(), ebcdic.data(), bulk_size);
+           sink = out[0];
+         }),
+         bulk_size);
+  report("iconv", time_ns(100, [&]() {
+           iconv_all(from_37, out.data(), ebcdic.data(), bulk_size);
+           sink = out[0];
+         }),
+         bulk_size);
+
+  // Space-padded fixed-width fields, like object names in API output
+  std::vector<char> fields(field_width * field_count);
+  for (size_t i = 0; i < field_count; i++) {
+    char name[field_width + 1];
+    int len = snprintf(name, sizeof(name), "OBJ%d", (int)(i % 100000));
+    a2e_pad(fields.data() + i * field_width, field_width, name, len);
+  }
+
+  printf("fields: %zu x %zu bytes, per field\n", field_count, field_width);
+  report("e2a_trim", time_ns(10, [&]() {
+           char name[field_width];
+           for (size_t i = 0; i < field_count; i++) {
+             size_t len = e2a_trim(name, fields.data() + i * field_width,
+                                   field_width);
+             sink = name[len - 1];
+           }
+         }) / field_count,
+         field_width);
+  report("iconv + trim", time_ns(10, [&]() {
+           char name[field_width];
+           for (size_t i = 0; i < field_count; i++) {
+             iconv_all(from_37, name, fields.data() + i * field_width,
+                       field_width);
+             size_t len = field_width;
+             while (len > 0 && name[len - 1] == ' ') {
+               len--;
+             }
+             sink = name[len - 1];
+           }
+         }) / field_count,
+         field_width);
+
+  // Half are known names, half aren't
+  for (size_t i = 0; i < field_count; i++) {
+    char name[field_width + 1];
+    int len = i % 2 == 0
+                  ? snprintf(name, sizeof(name), "%s",
+                             sysval_names[i / 2 % sysval_count])
+                  : snprintf(name, sizeof(name), "QSV%d", (int)(i % 1000));
+    a2e_pad(fields.data() + i * field_width, field_width, name, len);
+  }
+
+  printf("matching: %zu x %zu bytes against %zu names, per field\n",
+         field_count, field_width, sysval_count);
+  bool ok = true;
+  std::vector<size_t> found(field_count), expected_found(field_count);
+  auto linear = [&](const char *ascii, size_t len) {
+    for (size_t n = 0; n < sysval_count; n++) {
+      if (strlen(sysval_names[n]) == len &&
+          memcmp(sysval_names[n], ascii, len) == 0) {
+        return n;
+      }
+    }
+    return sysval_set.npos;
+  };
+  ok &= report_ns("iconv + strcmp", time_ns(10, [&]() {
+           char name[field_width];
+           for (size_t i = 0; i < field_count; i++) {
+             iconv_all(from_37, name, fields.data() + i * field_width,
+                       field_width);
+             size_t len = field_width;
+             while (len > 0 && name[len - 1] == ' ') {
+               len--;
+             }
+             expected_found[i] = linear(name, len);
+           }
+         }) / field_count);
+  ok &= report_ns("e2a_trim + strcmp", time_ns(10, [&]() {
+           char name[field_width];
+           for (size_t i = 0; i < field_count; i++) {
+             size_t len = e2a_trim(name, fields.data() + i * field_width,
+                                   field_width);
+             found[i] = linear(name, len);
+           }
+         }) / field_count);
+  if (found != expected_found) {
+    fprintf(stderr, "e2a_trim + strcmp: mismatch with iconv\n");
+    return 1;
+  }
+  ok &= report_ns("EbcdicNameSet::find", time_ns(10, [&]() {
+           for (size_t i = 0; i < field_count; i++) {
+             found[i] = sysval_set.find(fields.data() + i * field_width);
+           }
+         }) / field_count,
+         10);
+  if (found != expected_found) {
+    fprintf(stderr, "EbcdicNameSet::find: mismatch with iconv\n");
+    return 1;
+  }
+  ok &= report_ns("EbcdicView == \"QTIMZON\"_e", time_ns(10, [&]() {
+           for (size_t i = 0; i < field_count; i++) {
+             EbcdicView view(fields.data() + i * field_width, field_width);
+             found[i] = view == "QTIMZON"_e ? 15 : view != "QCCSID"_e;
+           }
+         }) / field_count,
+         10);
+  if ((found[30] == 15) != (expected_found[30] == 15)) {
+    fprintf(stderr, "EbcdicView ==: wrong match\n");
+    return 1;
+  }
+
+  // Half are system values, half aren't
+  for (size_t i = 0; i < field_count; i++) {
+    char name[field_width + 1];
+    int len = i % 2 == 0
+                  ? snprintf(name, sizeof(name), "%s",
+                             all_sysval_names[i / 2 % all_sysval_count])
+                  : snprintf(name, sizeof(name), "QSV%d", (int)(i % 1000));
+    a2e_pad(fields.data() + i * field_width, field_width, name, len);
+  }
+  printf("matching: %zu x %zu bytes against %zu names, per field\n",
+         field_count, field_width, all_sysval_count);
+  ok &= report_ns("EbcdicNameSet::find", time_ns(10, [&]() {
+           for (size_t i = 0; i < field_count; i++) {
+             found[i] = all_sysval_set.find(fields.data() + i * field_width);
+           }
+         }) / field_count,
+         10);
+  for (size_t i = 0; i < field_count; i++) {
+    size_t expected = i % 2 == 0 ? i / 2 % all_sysval_count
+                                 : all_sysval_set.npos;
+    if (found[i] != expected) {
+      fprintf(stderr, "EbcdicNameSet::find: wrong index for %zu names\n",
+              all_sysval_count);
+      return 1;
+    }
+  }
+
+  // Word-wide comparison of equal names, the worst case
+  std::vector<char> wide(28 * field_count);
+  for (size_t i = 0; i < field_count; i++) {
+    a2e_pad(wide.data() + i * 28, 28, "QSYS/QPADEV0001/QSECOFR", 23);
+  }
+  constexpr auto name28 = EbcdicFixedString<28>("QSYS/QPADEV0001/QSECOFR");
+  volatile size_t width = 28;
+  size_t matches = 0;
+  ok &= report_ns("ebcdic_equal<28>", time_ns(10, [&]() {
+           for (size_t i = 0; i < field_count; i++) {
+             matches += ebcdic_equal<28>(wide.data() + i * 28, name28.value);
+           }
+         }) / field_count,
+         10);
+  ok &= report_ns("memcmp 28", time_ns(10, [&]() {
+           for (size_t i = 0; i < field_count; i++) {
+             matches +=
+                 memcmp(wide.data() + i * 28, name28.value, width) == 0;
+           }
+         }) / field_count);
+  if (matches != 20 * field_count) {
+    fprintf(stderr, "ebcdic_equal<28>: wrong match\n");
+    return 1;
+  }
+
+  iconv_close(from_37);
+  iconv_close(to_37);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,99 @@
+// vim: expandtab:ts=2:sw=2
+/*
+ * Copyright (c) 2025 Seiden Group
+ *
+ * SPDX-License-Identifier: ISC
+ */
+
+/*
+ * Measures throughput and latency of calls through CallExecutor, against a
+ * stub procedure that sleeps like a slow system API, and checks that MI
+ * exceptions come back through the future.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "executor.hxx"
+#include "ilefunc.hxx"
+
+using namespace pase_cpp;
+
+static const int sleep_us = 1000;
+static const int call_count = 2000;
+
+static int slow(ILEarglist_base *base, const arg_type_t *, result_type_t) {
+  std::this_thread::sleep_for(std::chrono::microseconds(sleep_us));
+  base->result.s_int32.r_int32 = *(int32_t *)(base + 1) * 2;
+  return 0;
+}
+
+static int excp(ILEarglist_base *, const arg_type_t *, result_type_t) {
+  errno = STUB_EXCP_ERRNO;
+  return -1;
+}
+
+using Clock = std::chrono::steady_clock;
+
+static double us(Clock::duration d) {
+  return std::chrono::duration<double, std::micro>(d).count();
+}
+
+int main(void) {
+  stub_register_procedure("QSYS/STUB", "slow", slow);
+  stub_register_procedure("QSYS/STUB", "excp", excp);
+
+  auto f = ILEFunction<int32_t, int32_t>("QSYS/STUB", "slow");
+  auto e = ILEFunction<int32_t, int32_t>("QSYS/STUB", "excp");
+
+  try {
+    CallExecutor executor(0);
+    fprintf(stderr, "executor without workers was accepted\n");
+    return 1;
+  } catch (std::invalid_argument &) {
+  }
+
+  {
+    CallExecutor executor(2);
+    auto future = executor.submit(e, ILECallFlags{ILECALL_EXCP_NOSIGNAL}, 1);
+    try {
+      future.get();
+      fprintf(stderr, "MI exception wasn't propagated\n");
+      return 1;
+    } catch (std::runtime_error &) {
+    }
+  }
+
+  printf("%d calls sleeping %d us\n", call_count, sleep_us);
+  for (size_t threads : {1, 4, 16, 64}) {
+    std::vector<Clock::duration> latencies(call_count);
+    std::vector<std::future<int32_t>> futures;
+    auto begin = Clock::now();
+    {
+      CallExecutor executor(threads, 256);
+      for (int i = 0; i < call_count; i++) {
+        auto submitted = Clock::now();
+        futures.push_back(executor.submit([&f, &latencies, submitted, i]() {
+          int32_t ret = f(i);
+          latencies[i] = Clock::now() - submitted;
+          return ret;
+        }));
+      }
+      for (int i = 0; i < call_count; i++) {
+        if (futures[i].get() != i * 2) {
+          fprintf(stderr, "wrong result for call %d\n", i);
+          return 1;
+        }
+      }
+    }
+    auto elapsed = Clock::now() - begin;
+    std::sort(latencies.begin(), latencies.end());
+    printf("%3zu threads: %10.0f calls/s  p50 %10.0f us  p99 %10.0f us\n",
+           threads, call_count / us(elapsed) * 1e6,
+           us(latencies[call_count / 2]), us(latencies[call_count * 99 / 100]));
+  }
+  return 0;
+}
@@ -0,0 +1,153 @@
+// vim: expandtab:ts=2:sw=2
+/*
+ * Copyright (c) 2025 Seiden Group
+ *
+ * SPDX-License-Identifier: ISC
+ */
+
+/*
+ * Measures ILEFunction overhead against the stub as400_protos.h, and checks
+ * that activation and resolution are shared, thread-safe, and redone once
+ * after a fork.
+ */
+
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include <sys/wait.h>
+#include <unistd.h>
+}
+
+#include "ilefunc.hxx"
+
+#include "bench.hxx"
+
+using namespace pase_cpp;
+
+static const char *symbols[] = {"p00", "p01", "p02", "p03", "p04", "p05",
+                                "p06", "p07", "p08", "p09", "p10", "p11",
+                                "p12", "p13", "p14", "p15", "p16", "p17",
+                                "p18", "p19", "p20", "p21", "p22", "p23",
+                                "p24", "p25", "p26", "p27", "p28", "p29",
+                                "p30", "p31", "p32", "p33", "p34", "p35",
+                                "p36", "p37", "p38", "p39"};
+static const int symbol_count = sizeof(symbols) / sizeof(symbols[0]);
+
+static int add(ILEarglist_base *base, const arg_type_t *, result_type_t) {
+  int32_t *args = (int32_t *)(base + 1);
+  base->result.s_int32.r_int32 = args[0] + args[1];
+  return 0;
+}
+
+static int touch(ILEarglist_base *, const arg_type_t *, result_type_t) {
+  return 0;
+}
+
+static bool check(const char *what, unsigned long got, unsigned long want) {
+  if (got != want) {
+    fprintf(stderr, "%s: got %lu, expected %lu\n", what, got, want);
+    return false;
+  }
+  return true;
+}
+
+int main(void) {
+  for (auto symbol : symbols) {
+    stub_register_procedure("QSYS/STUB", symbol, add);
+  }
+  stub_register_procedure("QSYS/STUB", "touch", touch);
+  struct stub_counters *counters = stub_counters();
+
+  // 40 wrappers over one service program, first called from racing threads
+  std::vector<ILEFunction<int32_t, int32_t, int32_t>> functions;
+  for (auto symbol : symbols) {
+    functions.emplace_back("QSYS/STUB", symbol);
+  }
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; t++) {
+    threads.emplace_back([&]() {
+      for (auto &f : functions) {
+        f(1, 2);
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  if (!check("activations", counters->load, 1) ||
+      !check("resolves", counters->sym, symbol_count)) {
+    return 1;
+  }
+
+  // Duplicate declarations share the resolved symbol
+  auto duplicate = ILEFunction<int32_t, int32_t, int32_t>("QSYS/STUB", "p00");
+  if (duplicate(20, 22) != 42 || !check("resolves", counters->sym, 40)) {
+    return 1;
+  }
+
+  pid_t child = fork();
+  if (child == 0) {
+    for (auto &f : functions) {
+      f(1, 2);
+    }
+    bool ok = check("activations after fork", counters->load, 2) &&
+              check("resolves after fork", counters->sym, 2 * symbol_count);
+    _exit(ok ? 0 : 1);
+  }
+  int status;
+  waitpid(child, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    return 1;
+  }
+
+  auto &f = functions[0];
+  auto bound_add = f.bind(1, 2);
+  bound_add.set<1>(40);
+  if (bound_add() != 41) {
+    fprintf(stderr, "bound call: wrong result\n");
+    return 1;
+  }
+
+  bool ok = true;
+  ok &= report_ns("call int(int, int)",
+                  time_ns(10000000, [&]() { do_not_optimize(f(1, 2)); }), 200);
+
+  // A wider signature, where rebuilding the arglist costs more
+  char buffer[64];
+  auto wide = ILEFunction<void, char *, int32_t, char *, int64_t, double,
+                          char *, int32_t, int32_t>("QSYS/STUB", "touch");
+  ok &= report_ns("call void(8 args)", time_ns(10000000, [&]() {
+                    wide(buffer, 1, buffer, 2, 3.0, buffer, 4, 5);
+                  }),
+                  300);
+  auto bound = wide.bind(buffer, 1, buffer, 2, 3.0, buffer, 4, 5);
+  int32_t i = 0;
+  ok &= report_ns("bound call void(8 args)", time_ns(10000000, [&]() {
+                    bound.set<1>(i++);
+                    bound();
+                  }),
+                  150);
+
+  // Batches check activation and build the arglist once
+  const size_t batch_size = 1000;
+  std::vector<std::tuple<int32_t, int32_t>> batch_args;
+  for (size_t j = 0; j < batch_size; j++) {
+    batch_args.emplace_back(j, 1);
+  }
+  std::vector<int32_t> results(batch_size);
+  std::vector<int> batch_status(batch_size);
+  if (f.call_batch(batch_args.data(), batch_size, results.data(),
+                   batch_status.data()) != 0 ||
+      results[batch_size - 1] != batch_size) {
+    fprintf(stderr, "batch call: wrong result\n");
+    return 1;
+  }
+  ok &= report_ns("batch call int(int, int)", time_ns(10000, [&]() {
+                    f.call_batch(batch_args.data(), batch_size,
+                                 results.data());
+                  }) / batch_size,
+                  150);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+// vim: expandtab:ts=2:sw=2
+/*
+ * Copyright (c) 2025 Seiden Group
+ *
+ * SPDX-License-Identifier: ISC
+ */
+
+/*
+ * Measures the overhead of PASE_CPP_INSTRUMENT on calls and snapshots, and
+ * checks the counts add up across threads, including exited ones. Compare
+ * the call time with bench/ilefunc, built without it.
+ */
+
+#define PASE_CPP_INSTRUMENT
+
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "ilefunc.hxx"
+#include "pgmfunc.hxx"
+
+#include "bench.hxx"
+
+using namespace pase_cpp;
+
+static const int thread_count = 4;
+static const int calls_per_thread = 100000;
+
+static int add(ILEarglist_base *base, const arg_type_t *, result_type_t) {
+  int32_t *args = (int32_t *)(base + 1);
+  base->result.s_int32.r_int32 = args[0] + args[1];
+  return 0;
+}
+
+static int excp(ILEarglist_base *, const arg_type_t *, result_type_t) {
+  errno = STUB_EXCP_ERRNO;
+  return -1;
+}
+
+static int program(void **, unsigned) { return 0; }
+
+static const CallStats *find(const std::vector<CallStats> &stats,
+                             const char *name) {
+  for (auto &s : stats) {
+    if (s.name == name) {
+      return &s;
+    }
+  }
+  return nullptr;
+}
+
+int main(void) {
+  stub_register_procedure("QSYS/STUB", "add", add);
+  stub_register_procedure("QSYS/STUB", "excp", excp);
+  stub_register_program("QSYS", "STUB", program);
+
+  auto f = ILEFunction<int32_t, int32_t, int32_t>("QSYS/STUB", "add");
+  auto e = ILEFunction<int32_t>("QSYS/STUB", "excp", ILECALL_EXCP_NOSIGNAL);
+  auto p = PGMFunction<int>("QSYS", "STUB");
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < thread_count; t++) {
+    threads.emplace_back([&]() {
+      for (int i = 0; i < calls_per_thread; i++) {
+        f(i, 1);
+        p(i);
+      }
+      try {
+        e();
+      } catch (std::runtime_error &) {
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  // Duplicate wrappers find them in the cache, which isn't an activation
+  const int duplicate_count = 8;
+  std::vector<ILEFunction<int32_t, int32_t, int32_t>> f_duplicates(
+      duplicate_count,
+      ILEFunction<int32_t, int32_t, int32_t>("QSYS/STUB", "add"));
+  std::vector<PGMFunction<int>> p_duplicates(duplicate_count,
+                                             PGMFunction<int>("QSYS", "STUB"));
+  for (int i = 0; i < duplicate_count; i++) {
+    f_duplicates[i](i, 1);
+    p_duplicates[i](i);
+  }
+
+  auto stats = CallStatsRegistry::instance().snapshot();
+  const CallStats *fs = find(stats, "QSYS/STUB(add)");
+  const CallStats *es = find(stats, "QSYS/STUB(excp)");
+  const CallStats *ps = find(stats, "QSYS/STUB");
+  const uint64_t total = thread_count * calls_per_thread + duplicate_count;
+  if (fs == nullptr || es == nullptr || ps == nullptr || fs->calls != total ||
+      fs->results[(size_t)CallResult::ok] != total || fs->activations != 1 ||
+      es->results[(size_t)CallResult::exception] != thread_count ||
+      ps->calls != total || ps->activations != 1) {
+    fprintf(stderr, "counts don't add up\n");
+    return 1;
+  }
+
+  uint64_t histogram_total = 0;
+  for (auto count : fs->histogram) {
+    histogram_total += count;
+  }
+  if (histogram_total != total) {
+    fprintf(stderr, "histogram doesn't add up\n");
+    return 1;
+  }
+
+  bool ok = true;
+  ok &= report_ns("call int(int, int)",
+                  time_ns(10000000, [&]() { do_not_optimize(f(1, 2)); }), 500);
+  ok &= report_ns("snapshot", time_ns(10000, [&]() {
+                    CallStatsRegistry::instance().snapshot();
+                  }),
+                  20000);
+  return ok ? 0 : 1;
+}
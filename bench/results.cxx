@@ -0,0 +1,148 @@
+// vim: expandtab:ts=2:sw=2
+/*
+ * Copyright (c) 2025 Seiden Group
+ *
+ * SPDX-License-Identifier: ISC
+ */
+
+/*
+ * Compares returning structures into ResultArena slots against passing a
+ * pointer to the caller's own, with the structure from examples/structs.cxx,
+ * and checks slots stay in place, aligned, and contiguous for batches.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "ilefunc.hxx"
+
+#include "bench.hxx"
+
+using namespace pase_cpp;
+
+static const size_t iterations = 10000000;
+static const size_t batch_size = 1000;
+
+struct example {
+  long long a;
+  long long b;
+  long long c;
+  long long d;
+  long long e;
+};
+
+// struct example func(int i), like in examples/structs.cxx
+static int func(ILEarglist_base *base, const arg_type_t *, result_type_t) {
+  int32_t i = *(int32_t *)(base + 1);
+  struct example *x = (struct example *)base->result.r_aggregate.s.addr;
+  x->a = i + 0;
+  x->b = i + 1;
+  x->c = i + 2;
+  x->d = i + 3;
+  x->e = i + 4;
+  return 0;
+}
+
+static bool check(const char *what, const struct example &x, int i) {
+  if (x.a != i || x.b != i + 1 || x.c != i + 2 || x.d != i + 3 ||
+      x.e != i + 4) {
+    fprintf(stderr, "%s: wrong structure for %d\n", what, i);
+    return false;
+  }
+  return true;
+}
+
+static bool aligned(const void *p) { return (uintptr_t)p % 16 == 0; }
+
+static volatile int32_t value = 42;
+
+int main(void) {
+  stub_register_procedure("CALVIN/TESTILE", "func", func);
+  auto f = ILEFunction<struct example, int>("CALVIN/TESTILE", "func");
+
+  // Handles refer to where the call wrote, even after moving
+  auto result = f(42);
+  const struct example *written = result.get();
+  auto moved = std::move(result);
+  if (!check("ILEResult", *moved, 42) || moved.get() != written ||
+      !aligned(written)) {
+    fprintf(stderr, "result moved or misaligned\n");
+    return 1;
+  }
+
+  // More than fit in a chunk, all still live
+  std::vector<ILEResult<struct example>> held;
+  for (int i = 0; i < 10000; i++) {
+    held.push_back(f(i));
+  }
+  for (int i = 0; i < 10000; i++) {
+    if (!check("held", *held[i], i) || !aligned(held[i].get())) {
+      return 1;
+    }
+  }
+
+  // Released on another thread
+  std::thread([&]() { held.clear(); }).join();
+
+  auto bound = f.bind(7);
+  if (!check("bound", *bound(), 7)) {
+    return 1;
+  }
+
+  std::vector<std::tuple<int>> args;
+  for (size_t i = 0; i < batch_size; i++) {
+    args.emplace_back(i);
+  }
+  ILEResults<struct example> results;
+  if (f.call_batch(args.data(), batch_size, results) != 0 ||
+      results.size() != batch_size || !aligned(results.data())) {
+    fprintf(stderr, "batch failed\n");
+    return 1;
+  }
+  for (size_t i = 0; i < batch_size; i++) {
+    if (!check("batch", results[i], i)) {
+      return 1;
+    }
+  }
+
+  bool ok = true;
+  printf("struct example(int)\n");
+  ok &= report_ns("caller pointer", time_ns(iterations, [&]() {
+                    struct example x;
+                    f(&x, value);
+                    do_not_optimize(x);
+                  }),
+                  150);
+  ok &= report_ns("ILEResult", time_ns(iterations, [&]() {
+                    auto x = f(value);
+                    do_not_optimize(x->e);
+                  }),
+                  150);
+  ok &= report_ns("bound ILEResult", time_ns(iterations, [&]() {
+                    auto x = bound();
+                    do_not_optimize(x->e);
+                  }),
+                  150);
+  printf("batches of %zu, per call\n", batch_size);
+  std::vector<struct example> vector_results(batch_size);
+  ok &= report_ns("call_batch into vector",
+                  time_ns(iterations / batch_size, [&]() {
+                    f.call_batch(args.data(), batch_size,
+                                 vector_results.data());
+                    do_not_optimize(vector_results[batch_size - 1]);
+                  }) / batch_size,
+                  100);
+  ok &= report_ns("call_batch into ILEResults",
+                  time_ns(iterations / batch_size, [&]() {
+                    ILEResults<struct example> batch;
+                    f.call_batch(args.data(), batch_size, batch);
+                    do_not_optimize(batch[batch_size - 1]);
+                  }) / batch_size,
+                  100);
+
+  return ok ? 0 : 1;
+}
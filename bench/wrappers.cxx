@@ -0,0 +1,358 @@
+// vim: expandtab:ts=2:sw=2
+/*
+ * Copyright (c) 2025 Seiden Group
+ *
+ * SPDX-License-Identifier: ISC
+ */
+
+/*
+ * Micro-benchmarks for the pieces of the wrappers that run on every call,
+ * against the stub as400_protos.h, with thresholds to catch regressions.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <tuple>
+#include <vector>
+
+#include "ebcdic.hxx"
+#include "ilefunc.hxx"
+#include "pgmfunc.hxx"
+#include "receiver.hxx"
+#include "records.hxx"
+
+#include "bench.hxx"
+
+using namespace pase_cpp;
+
+static const size_t iterations = 10000000;
+
+static int program(void **, unsigned) { return 0; }
+
+// Adds its first two arguments into the third
+static int adder(void **argv, unsigned) {
+  *(int *)argv[2] = *(int *)argv[0] + *(int *)argv[1];
+  return 0;
+}
+
+// Like adder, but only when called without signalling MI exceptions
+static int batch_adder(void **argv, unsigned flags) {
+  if (!(flags & PGMCALL_EXCP_NOSIGNAL)) {
+    return 1;
+  }
+  return adder(argv, flags);
+}
+
+static const int retrieved_size = 6000;
+
+// A retrieve API with retrieved_size bytes of output, like QWCRTVTZ
+static int retriever(void **argv, unsigned) {
+  ReceiverHeader *header = (ReceiverHeader *)argv[0];
+  int length = *(int *)argv[1];
+  int returned = length < retrieved_size ? length : retrieved_size;
+  memset(argv[0], 'X'_e, returned);
+  header->bytes_returned = returned;
+  header->bytes_available = retrieved_size;
+  return 0;
+}
+
+// Like Qus_EC_t, for a typical by-reference struct argument
+struct error_code {
+  int bytes_provided;
+  int bytes_available;
+  char exception_id[7];
+  char reserved;
+};
+
+static volatile int32_t value = 42;
+
+// QWCRSVAL's receiver format
+struct sysval_entry {
+  char name[10];
+  char type;
+  char status;
+  int length;
+  char data[];
+};
+
+struct sysval_header {
+  int count;
+  int offsets[];
+};
+
+using SysvalTable =
+    OffsetTableView<sysval_header, sysval_entry, offsetof(sysval_header, count),
+                    offsetof(sysval_header, offsets)>;
+
+// A synthetic receiver with count entries of 10 bytes of data each
+static std::vector<char> sysval_receiver(int count) {
+  const size_t entry_size = sizeof(sysval_entry) + 12;
+  std::vector<char> buffer(sizeof(int) * (count + 1) + entry_size * count);
+  sysval_header *header = (sysval_header *)buffer.data();
+  header->count = count;
+  for (int i = 0; i < count; i++) {
+    header->offsets[i] = sizeof(int) * (count + 1) + entry_size * i;
+    sysval_entry *entry = (sysval_entry *)(buffer.data() + header->offsets[i]);
+    char name[11];
+    int len = snprintf(name, sizeof(name), "QSV%d", i);
+    a2e_pad(entry->name, sizeof(entry->name), name, len);
+    entry->type = 'C'_e;
+    entry->length = 10;
+    a2e_pad(entry->data, 10, "VALUE", 5);
+  }
+  return buffer;
+}
+
+int main(void) {
+  stub_register_program("QSYS", "STUB", program);
+  stub_register_program("QSYS", "RETRIEVE", retriever);
+  stub_register_program("QSYS", "ADD", adder);
+  stub_register_program("QSYS", "BATCHADD", batch_adder);
+  stub_register_program("QSYS", "PREWARM1", program);
+  stub_register_program("QSYS", "PREWARM2", program);
+  stub_register_program("QSYS", "PREWARM3", program);
+
+  char buffer[64];
+  bool ok = true;
+
+  printf("ILEArglist construction\n");
+  ok &= report_ns("int()", time_ns(iterations, [&]() {
+                    auto arguments = ILEArglist<>();
+                    do_not_optimize(arguments);
+                  }),
+                  20);
+  ok &= report_ns("int(int, int)", time_ns(iterations, [&]() {
+                    auto arguments = ILEArglist<int32_t, int32_t>(value, 2);
+                    do_not_optimize(arguments);
+                  }),
+                  20);
+  ok &= report_ns("void(int8, double, int64)", time_ns(iterations, [&]() {
+                    auto arguments =
+                        ILEArglist<int8_t, double, int64_t>(value, 2.0, 3);
+                    do_not_optimize(arguments);
+                  }),
+                  20);
+  ok &= report_ns("void(6 args, 3 pointers)", time_ns(iterations, [&]() {
+                    auto arguments =
+                        ILEArglist<char *, char *, const char *, uint32_t,
+                                   uint32_t, char *>(buffer, buffer, buffer,
+                                                     value, 37, buffer);
+                    do_not_optimize(arguments);
+                  }),
+                  40);
+  ok &= report_ns("void(32 x int)", time_ns(iterations, [&]() {
+                    auto arguments = ILEArglist<
+                        int, int, int, int, int, int, int, int, int, int, int,
+                        int, int, int, int, int, int, int, int, int, int, int,
+                        int, int, int, int, int, int, int, int, int, int>(
+                        value, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+                        15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28,
+                        29, 30, 31);
+                    do_not_optimize(arguments);
+                  }),
+                  80);
+
+  printf("ILEArgument<T *>::write\n");
+  alignas(16) char slot[sizeof(ILEpointer)] = {};
+  ok &= report_ns("pointer lifting", time_ns(iterations, [&]() {
+                    ILEArgument<char *>::write(slot, buffer + value);
+                    do_not_optimize(slot);
+                  }),
+                  5);
+
+  printf("PGMFunction resolution\n");
+  auto resolved = stub_counters()->rslobj;
+  std::vector<PGMFunction<int>> duplicates(32,
+                                           PGMFunction<int>("QSYS", "STUB"));
+  auto missing = PGMFunction<int>("QSYS", "MISSING");
+  if (stub_counters()->rslobj != resolved) {
+    fprintf(stderr, "programs resolved before their first call\n");
+    return 1;
+  }
+  for (auto &duplicate : duplicates) {
+    duplicate(1);
+  }
+  bool thrown = false;
+  try {
+    missing(1);
+  } catch (std::invalid_argument &) {
+    thrown = true;
+  }
+  if (!thrown || stub_counters()->rslobj - resolved != 2) {
+    fprintf(stderr, "duplicate programs weren't resolved once\n");
+    return 1;
+  }
+  auto prewarm1 = PGMFunction<>("QSYS", "PREWARM1");
+  auto prewarm2 = PGMFunction<int>("QSYS", "PREWARM2");
+  auto prewarm3 = PGMFunction<int, int>("QSYS", "PREWARM3");
+  resolved = stub_counters()->rslobj;
+  prewarm(prewarm1, prewarm2, prewarm3);
+  prewarm1();
+  prewarm2(1);
+  prewarm3(1, 2);
+  if (stub_counters()->rslobj - resolved != 3) {
+    fprintf(stderr, "prewarmed programs were resolved again\n");
+    return 1;
+  }
+  ok &= report_ns("construct", time_ns(iterations / 10, [&]() {
+                    auto f = PGMFunction<int>("QSYS", "STUB");
+                    do_not_optimize(f);
+                  }),
+                  200);
+  ok &= report_ns("first call, cached", time_ns(iterations / 10, [&]() {
+                    auto f = PGMFunction<int>("QSYS", "STUB");
+                    do_not_optimize(f(1));
+                  }),
+                  400);
+
+  printf("PGMFunction argv\n");
+  error_code err = {};
+  ok &= report_ns("ParameterArrayMember x 5", time_ns(iterations, [&]() {
+                    int32_t length = value;
+                    void *argv[] = {ParameterArrayMember(buffer),
+                                    ParameterArrayMember(length),
+                                    ParameterArrayMember(1),
+                                    ParameterArrayMember((char *)buffer),
+                                    ParameterArrayMember(&err), NULL};
+                    do_not_optimize(argv);
+                  }),
+                  10);
+  auto pgm = PGMFunction<void *, int, int, char *, error_code *>("QSYS", "STUB");
+  ok &= report_ns("call 5 args", time_ns(iterations, [&]() {
+                    do_not_optimize(pgm(buffer, value, 1, buffer, &err));
+                  }),
+                  50);
+  auto pgm8 = PGMFunction<int, int, int, int, int, int, int, int>("QSYS", "STUB");
+  ok &= report_ns("call 8 x int", time_ns(iterations, [&]() {
+                    do_not_optimize(pgm8(value, 2, 3, 4, 5, 6, 7, 8));
+                  }),
+                  50);
+
+  // Value arguments are written back to the tuples
+  auto batch_add = PGMFunction<int, int, int>("QSYS", "BATCHADD");
+  std::tuple<int, int, int> sums[] = {
+      std::make_tuple(1, 2, 0), std::make_tuple(40, 2, 0)};
+  if (batch_add.call_batch(sums, 2) != 0 || std::get<2>(sums[0]) != 3 ||
+      std::get<2>(sums[1]) != 42) {
+    fprintf(stderr, "batch didn't write back to its arguments\n");
+    return 1;
+  }
+
+  printf("PGMDirectFunction\n");
+  auto add = PGMFunction<int, int, int *>("QSYS", "ADD");
+  auto add_direct = PGMDirectFunction<int, int, int *>("QSYS", "ADD");
+  int sum = 0, sum_direct = 0, sum_moved = 0;
+  add(40, 2, &sum);
+  add_direct(40, 2, &sum_direct);
+  // The output moved, so its pointer has to be set again
+  add_direct(1, 2, &sum_moved);
+  if (sum != 42 || sum_direct != 42 || sum_moved != 3) {
+    fprintf(stderr, "direct arguments didn't reach the program\n");
+    return 1;
+  }
+  auto direct = PGMDirectFunction<void *, int, int, char *, error_code *>(
+      "QSYS", "STUB");
+  ok &= report_ns("call 5 args", time_ns(iterations, [&]() {
+                    do_not_optimize(direct(buffer, value, 1, buffer, &err));
+                  }),
+                  100);
+  auto direct8 = PGMDirectFunction<int, int, int, int, int, int, int, int>(
+      "QSYS", "STUB");
+  ok &= report_ns("call 8 x int", time_ns(iterations, [&]() {
+                    do_not_optimize(direct8(value, 2, 3, 4, 5, 6, 7, 8));
+                  }),
+                  100);
+
+  printf("EBCDIC\n");
+  const char *name = "QCCSID";
+  ok &= report_ns("EbcdicFixedString<10>", time_ns(iterations, [&]() {
+                    do_not_optimize(EbcdicFixedString<10>(name));
+                  }),
+                  40);
+  ok &= report_ns("a2e_pad 10", time_ns(iterations, [&]() {
+                    char field[10];
+                    a2e_pad(field, sizeof(field), name, 6);
+                    do_not_optimize(field);
+                  }),
+                  40);
+  auto literal = "QSYS0100"_e;
+  ok &= report_ns("e2a_trim 8", time_ns(iterations, [&]() {
+                    char out[8];
+                    do_not_optimize(e2a_trim(out, literal, 8));
+                    do_not_optimize(out);
+                  }),
+                  40);
+
+  printf("Record views (100 entries)\n");
+  auto receiver = sysval_receiver(100);
+  ok &= report_ns("cast and walk", time_ns(iterations / 100, [&]() {
+                    sysval_header *header = (sysval_header *)receiver.data();
+                    int total = 0;
+                    for (int i = 0; i < header->count; i++) {
+                      sysval_entry *entry =
+                          (sysval_entry *)(receiver.data() +
+                                           header->offsets[i]);
+                      total += entry->length + entry->data[0];
+                    }
+                    do_not_optimize(total);
+                  }),
+                  1000);
+  ok &= report_ns("OffsetTableView", time_ns(iterations / 100, [&]() {
+                    int total = 0;
+                    for (auto entry :
+                         SysvalTable(receiver.data(), receiver.size())) {
+                      total += entry->length +
+                               *entry.bytes(offsetof(sysval_entry, data),
+                                            entry->length);
+                    }
+                    do_not_optimize(total);
+                  }),
+                  2000);
+  auto truncated = SysvalTable(receiver.data(), receiver.size() - 16);
+  try {
+    for (auto entry : truncated) {
+      entry.bytes(offsetof(sysval_entry, data), entry->length);
+    }
+    fprintf(stderr, "truncated receiver wasn't caught\n");
+    return 1;
+  } catch (std::out_of_range &) {
+  }
+  if (SysvalTable(receiver.data(), receiver.size())[99]
+          .ebcdic(&sysval_entry::name)
+          .str() != "QSV99") {
+    fprintf(stderr, "wrong name from record view\n");
+    return 1;
+  }
+
+  printf("Receivers (%d bytes available)\n", retrieved_size);
+  auto retrieve_pgm = PGMFunction<char *, int>("QSYS", "RETRIEVE");
+  auto calls = stub_counters()->pgmcall;
+  auto received = retrieve(
+      [&](char *rcv, int length) { retrieve_pgm(rcv, length); }, 1024);
+  if (received.truncated() || stub_counters()->pgmcall - calls != 2) {
+    fprintf(stderr, "receiver wasn't grown\n");
+    return 1;
+  }
+  ok &= report_ns("stack buffer 16K", time_ns(iterations / 100, [&]() {
+                    char rcv[16 * 1024] = {};
+                    retrieve_pgm(rcv, sizeof(rcv));
+                    do_not_optimize(rcv);
+                  }),
+                  2000);
+  ok &= report_ns("retrieve 8K", time_ns(iterations / 100, [&]() {
+                    auto rcv = retrieve([&](char *rcv, int length) {
+                      retrieve_pgm(rcv, length);
+                    }, 8192);
+                    do_not_optimize(rcv.data());
+                  }),
+                  1000);
+  ok &= report_ns("retrieve 1K, grown", time_ns(iterations / 100, [&]() {
+                    auto rcv = retrieve([&](char *rcv, int length) {
+                      retrieve_pgm(rcv, length);
+                    }, 1024);
+                    do_not_optimize(rcv.data());
+                  }),
+                  1500);
+
+  return ok ? 0 : 1;
+}
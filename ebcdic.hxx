@@ -8,6 +8,10 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
 
 namespace pase_cpp {
 
@@ -49,10 +53,89 @@ constexpr unsigned char const ANSI_X3_4_1968_IBM037[256] = {
     56,  57,  250, 251, 252, 253, 254, 255, /* 248 - 255  */
 };
 
+/* The literals below only use the table above for 7-bit ASCII, where
+   recode agrees with CCSID 37; the rest of it is filler to make it
+   reversible. For data, these are the real CCSID 37 <-> ISO-8859-1 tables,
+   which map all 256 bytes one to one, the same as iconv.  */
+
+constexpr unsigned char const ISO_8859_1_IBM037[256] = {
+    0,   1,   2,   3,   55,  45,  46,  47,  /*   0 -   7  */
+    22,  5,   37,  11,  12,  13,  14,  15,  /*   8 -  15  */
+    16,  17,  18,  19,  60,  61,  50,  38,  /*  16 -  23  */
+    24,  25,  63,  39,  28,  29,  30,  31,  /*  24 -  31  */
+    64,  90,  127, 123, 91,  108, 80,  125, /*  32 -  39  */
+    77,  93,  92,  78,  107, 96,  75,  97,  /*  40 -  47  */
+    240, 241, 242, 243, 244, 245, 246, 247, /*  48 -  55  */
+    248, 249, 122, 94,  76,  126, 110, 111, /*  56 -  63  */
+    124, 193, 194, 195, 196, 197, 198, 199, /*  64 -  71  */
+    200, 201, 209, 210, 211, 212, 213, 214, /*  72 -  79  */
+    215, 216, 217, 226, 227, 228, 229, 230, /*  80 -  87  */
+    231, 232, 233, 186, 224, 187, 176, 109, /*  88 -  95  */
+    121, 129, 130, 131, 132, 133, 134, 135, /*  96 - 103  */
+    136, 137, 145, 146, 147, 148, 149, 150, /* 104 - 111  */
+    151, 152, 153, 162, 163, 164, 165, 166, /* 112 - 119  */
+    167, 168, 169, 192, 79,  208, 161, 7,   /* 120 - 127  */
+    32,  33,  34,  35,  36,  21,  6,   23,  /* 128 - 135  */
+    40,  41,  42,  43,  44,  9,   10,  27,  /* 136 - 143  */
+    48,  49,  26,  51,  52,  53,  54,  8,   /* 144 - 151  */
+    56,  57,  58,  59,  4,   20,  62,  255, /* 152 - 159  */
+    65,  170, 74,  177, 159, 178, 106, 181, /* 160 - 167  */
+    189, 180, 154, 138, 95,  202, 175, 188, /* 168 - 175  */
+    144, 143, 234, 250, 190, 160, 182, 179, /* 176 - 183  */
+    157, 218, 155, 139, 183, 184, 185, 171, /* 184 - 191  */
+    100, 101, 98,  102, 99,  103, 158, 104, /* 192 - 199  */
+    116, 113, 114, 115, 120, 117, 118, 119, /* 200 - 207  */
+    172, 105, 237, 238, 235, 239, 236, 191, /* 208 - 215  */
+    128, 253, 254, 251, 252, 173, 174, 89,  /* 216 - 223  */
+    68,  69,  66,  70,  67,  71,  156, 72,  /* 224 - 231  */
+    84,  81,  82,  83,  88,  85,  86,  87,  /* 232 - 239  */
+    140, 73,  205, 206, 203, 207, 204, 225, /* 240 - 247  */
+    112, 221, 222, 219, 220, 141, 142, 223, /* 248 - 255  */
+};
+
+constexpr unsigned char const IBM037_ISO_8859_1[256] = {
+    0,   1,   2,   3,   156, 9,   134, 127, /*   0 -   7  */
+    151, 141, 142, 11,  12,  13,  14,  15,  /*   8 -  15  */
+    16,  17,  18,  19,  157, 133, 8,   135, /*  16 -  23  */
+    24,  25,  146, 143, 28,  29,  30,  31,  /*  24 -  31  */
+    128, 129, 130, 131, 132, 10,  23,  27,  /*  32 -  39  */
+    136, 137, 138, 139, 140, 5,   6,   7,   /*  40 -  47  */
+    144, 145, 22,  147, 148, 149, 150, 4,   /*  48 -  55  */
+    152, 153, 154, 155, 20,  21,  158, 26,  /*  56 -  63  */
+    32,  160, 226, 228, 224, 225, 227, 229, /*  64 -  71  */
+    231, 241, 162, 46,  60,  40,  43,  124, /*  72 -  79  */
+    38,  233, 234, 235, 232, 237, 238, 239, /*  80 -  87  */
+    236, 223, 33,  36,  42,  41,  59,  172, /*  88 -  95  */
+    45,  47,  194, 196, 192, 193, 195, 197, /*  96 - 103  */
+    199, 209, 166, 44,  37,  95,  62,  63,  /* 104 - 111  */
+    248, 201, 202, 203, 200, 205, 206, 207, /* 112 - 119  */
+    204, 96,  58,  35,  64,  39,  61,  34,  /* 120 - 127  */
+    216, 97,  98,  99,  100, 101, 102, 103, /* 128 - 135  */
+    104, 105, 171, 187, 240, 253, 254, 177, /* 136 - 143  */
+    176, 106, 107, 108, 109, 110, 111, 112, /* 144 - 151  */
+    113, 114, 170, 186, 230, 184, 198, 164, /* 152 - 159  */
+    181, 126, 115, 116, 117, 118, 119, 120, /* 160 - 167  */
+    121, 122, 161, 191, 208, 221, 222, 174, /* 168 - 175  */
+    94,  163, 165, 183, 169, 167, 182, 188, /* 176 - 183  */
+    189, 190, 91,  93,  175, 168, 180, 215, /* 184 - 191  */
+    123, 65,  66,  67,  68,  69,  70,  71,  /* 192 - 199  */
+    72,  73,  173, 244, 246, 242, 243, 245, /* 200 - 207  */
+    125, 74,  75,  76,  77,  78,  79,  80,  /* 208 - 215  */
+    81,  82,  185, 251, 252, 249, 250, 255, /* 216 - 223  */
+    92,  247, 83,  84,  85,  86,  87,  88,  /* 224 - 231  */
+    89,  90,  178, 212, 214, 210, 211, 213, /* 232 - 239  */
+    48,  49,  50,  51,  52,  53,  54,  55,  /* 240 - 247  */
+    56,  57,  179, 219, 220, 217, 218, 159, /* 248 - 255  */
+};
+
 static constexpr char a2e(char a) {
   return ANSI_X3_4_1968_IBM037[(unsigned char)a];
 }
 
+static constexpr char e2a(char e) {
+  return IBM037_ISO_8859_1[(unsigned char)e];
+}
+
 /**
  * User-defined literal for EBCDIC characters. Useful for interfaces on
  * IBM i that take a zoned integer as a boolean; i.e. 0xF1 for '1'.
@@ -92,4 +175,428 @@ template <typename T, T... str> constexpr auto operator""_e() {
   return ef;
 }
 
+/*
+ * Runtime transcoding of buffers, for data that isn't known at compile time
+ * (i.e. API output). These convert between CCSID 37 and ISO-8859-1 with
+ * the tables above, exactly like iconv, but without iconv_open per call.
+ * Source and destination may be the same buffer, but not otherwise overlap.
+ */
+
+inline void transcode(char *dst, const char *src, size_t len,
+                      const unsigned char *table) {
+  for (size_t i = 0; i < len; i++) {
+    dst[i] = table[(unsigned char)src[i]];
+  }
+}
+
+/**
+ * Converts len bytes of ASCII in src to EBCDIC in dst.
+ */
+inline void a2e(char *dst, const char *src, size_t len) {
+  transcode(dst, src, len, ISO_8859_1_IBM037);
+}
+
+/**
+ * Converts len bytes of EBCDIC in src to ASCII in dst.
+ */
+inline void e2a(char *dst, const char *src, size_t len) {
+  transcode(dst, src, len, IBM037_ISO_8859_1);
+}
+
+/**
+ * Converts a fixed-width EBCDIC field to ASCII, dropping the trailing
+ * EBCDIC spaces that pad it. The trailing spaces are found first, so they
+ * aren't converted at all. Returns the length written to dst; dst isn't
+ * NUL terminated.
+ */
+inline size_t e2a_trim(char *dst, const char *src, size_t len) {
+  while (len > 0 && src[len - 1] == ' '_e) {
+    len--;
+  }
+  e2a(dst, src, len);
+  return len;
+}
+
+/**
+ * Converts ASCII to a fixed-width EBCDIC field of dst_len bytes, padding it
+ * with EBCDIC spaces, like EbcdicFixedString does at compile time. src is
+ * truncated if it doesn't fit.
+ */
+inline void a2e_pad(char *dst, size_t dst_len, const char *src,
+                    size_t src_len) {
+  if (src_len > dst_len) {
+    src_len = dst_len;
+  }
+  a2e(dst, src, src_len);
+  memset(dst + src_len, ' '_e, dst_len - src_len);
+}
+
+/*
+ * Matching fixed-width EBCDIC fields (i.e. names in API output) against
+ * names known at compile time, without converting them.
+ */
+
+/**
+ * Compares Len bytes of two fields a word at a time; with Len known at
+ * compile time, i.e. 10, 20, or 28 byte names, this is a few loads and no
+ * loop.
+ */
+template <size_t Len> inline bool ebcdic_equal(const char *a, const char *b) {
+  uint64_t diff = 0;
+  size_t i = 0;
+  for (; i + 8 <= Len; i += 8) {
+    uint64_t x, y;
+    memcpy(&x, a + i, sizeof(x));
+    memcpy(&y, b + i, sizeof(y));
+    diff |= x ^ y;
+  }
+  if (Len - i >= 4) {
+    uint32_t x, y;
+    memcpy(&x, a + i, sizeof(x));
+    memcpy(&y, b + i, sizeof(y));
+    diff |= x ^ y;
+    i += 4;
+  }
+  if (Len - i >= 2) {
+    uint16_t x, y;
+    memcpy(&x, a + i, sizeof(x));
+    memcpy(&y, b + i, sizeof(y));
+    diff |= x ^ y;
+    i += 2;
+  }
+  if (Len - i >= 1) {
+    diff |= (unsigned char)(a[i] ^ b[i]);
+  }
+  return diff == 0;
+}
+
+/**
+ * If len bytes of a field are all EBCDIC spaces.
+ */
+inline bool ebcdic_blank(const char *field, size_t len) {
+  const uint64_t spaces = (unsigned char)' '_e * 0x0101010101010101ULL;
+  size_t i = 0;
+  for (; i + 8 <= len; i += 8) {
+    uint64_t word;
+    memcpy(&word, field + i, sizeof(word));
+    if (word != spaces) {
+      return false;
+    }
+  }
+  for (; i < len; i++) {
+    if (field[i] != ' '_e) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * A fixed-width EBCDIC field in someone else's buffer, i.e. API output.
+ * Nothing is converted until asked for.
+ */
+class EbcdicView {
+public:
+  constexpr EbcdicView(const char *data, size_t size)
+      : field(data), field_size(size) {}
+
+  constexpr const char *data() const { return this->field; }
+  constexpr size_t size() const { return this->field_size; }
+
+  /**
+   * Convert to ASCII in dst, which must be size() bytes, without trailing
+   * spaces. Returns the length; dst isn't NUL terminated.
+   */
+  size_t copy(char *dst) const {
+    return e2a_trim(dst, this->field, this->field_size);
+  }
+
+  /**
+   * Convert to ASCII, without trailing spaces.
+   */
+  std::string str() const {
+    std::string ascii(this->field_size, '\0');
+    ascii.resize(this->copy(&ascii[0]));
+    return ascii;
+  }
+
+  /**
+   * If the field is the literal, padded with spaces to the field's width;
+   * i.e. view == "QCCSID"_e. Nothing is converted.
+   */
+  template <size_t Len>
+  bool operator==(const EbcdicFixedString<Len> &literal) const {
+    return this->field_size >= Len &&
+           ebcdic_equal<Len>(this->field, literal.value) &&
+           ebcdic_blank(this->field + Len, this->field_size - Len);
+  }
+
+  template <size_t Len>
+  bool operator!=(const EbcdicFixedString<Len> &literal) const {
+    return !(*this == literal);
+  }
+
+private:
+  const char *field;
+  size_t field_size;
+};
+
+// A table at most half full
+constexpr size_t ebcdic_name_slots(size_t count) {
+  size_t slots = 1;
+  while (slots < count * 2) {
+    slots <<= 1;
+  }
+  return slots;
+}
+
+/**
+ * A set of names in Len byte EBCDIC fields (i.e. system values, formats, or
+ * object types), with a perfect hash found at compile time, so a field from
+ * API output is looked up with one hash and one comparison, and without
+ * converting it. find returns the name's index, in the order given, or npos.
+ * index gets the same index from the ASCII name at compile time, so lookups
+ * can be dispatched with a switch:
+ *
+ *   static constexpr auto names = ebcdic_names<10>("QCCSID", "QDATFMT");
+ *   auto name = sysval.ebcdic(&Qwc_Rsval_Sys_Value_Table_t::System_Value);
+ *   switch (names.find(name)) {
+ *   case names.index("QCCSID"):
+ *     // ...
+ *   }
+ *
+ * The hash is hash and displace: the high bits of the hash pick a bucket of
+ * a few names, and the bucket's displacement, XORed with the low bits, picks
+ * the slot. Displacements are found a bucket at a time, largest first, so
+ * building the set takes time linear in the number of names, not a search
+ * for one seed that doesn't collide anywhere.
+ *
+ * Names that don't fit, duplicate names, and names that aren't in the set
+ * passed to index are errors at compile time (if the set is constexpr).
+ */
+template <size_t Len, size_t Count> class EbcdicNameSet {
+  static_assert(Count > 0, "name sets can't be empty");
+  static constexpr size_t slots = ebcdic_name_slots(Count);
+  // About two names per bucket
+  static constexpr size_t buckets = slots / 4 > 0 ? slots / 4 : 1;
+  // A seed fails if two names in a bucket share their low bits, which
+  // happens for about one seed in five with 150 names
+  static constexpr uint64_t max_seed = 64;
+
+public:
+  static constexpr size_t npos = (size_t)-1;
+
+  constexpr EbcdicNameSet(const char *const (&ascii)[Count])
+      : names(), table(), displacements(), seed(0) {
+    for (size_t i = 0; i < Count; i++) {
+      EbcdicFixedString<Len> name(ascii[i]);
+      size_t length = 0;
+      while (ascii[i][length] != '\0') {
+        length++;
+      }
+      if (length > Len) {
+        throw std::invalid_argument("name longer than the field");
+      }
+      for (size_t j = 0; j < Len; j++) {
+        this->names[i][j] = name.value[j];
+      }
+    }
+    for (uint64_t seed = 1; this->seed == 0; seed++) {
+      if (seed > max_seed) {
+        throw std::logic_error("no perfect hash found");
+      }
+      if (this->place(seed)) {
+        this->seed = seed;
+      }
+    }
+  }
+
+  /**
+   * Look up a field of Len bytes.
+   */
+  size_t find(const char *field) const {
+    // Empty slots hold 0, a valid index; the comparison rules them out,
+    // without another branch.
+    uint64_t h = hash_words(field, this->seed);
+    size_t i = this->table[slot(h, this->displacements[bucket(h)])];
+    return ebcdic_equal<Len>(field, this->names[i]) ? i : npos;
+  }
+
+  size_t find(const EbcdicView &view) const {
+    return view.size() == Len ? this->find(view.data()) : npos;
+  }
+
+  /**
+   * The index of an ASCII name, for case labels.
+   */
+  constexpr size_t index(const char *ascii) const {
+    EbcdicFixedString<Len> name(ascii);
+    for (size_t i = 0; i < Count; i++) {
+      if (same(this->names[i], name.value)) {
+        return i;
+      }
+    }
+    throw std::invalid_argument("name not in the set");
+  }
+
+  constexpr size_t size() const { return Count; }
+
+  constexpr EbcdicView name(size_t index) const {
+    return EbcdicView(this->names[index], Len);
+  }
+
+private:
+  static constexpr size_t bucket(uint64_t h) {
+    return (size_t)(h >> 32) & (buckets - 1);
+  }
+
+  static constexpr size_t slot(uint64_t h, size_t displacement) {
+    return ((size_t)h ^ displacement) & (slots - 1);
+  }
+
+  /*
+   * Fill the table with this seed, or return false if a bucket can't be
+   * placed; the table is cleared first, so a failed seed leaves nothing
+   * behind for the next one.
+   */
+  constexpr bool place(uint64_t seed) {
+    uint64_t hashes[Count] = {};
+    // Names sorted by bucket: bucket b's are order[start[b]..start[b + 1])
+    size_t start[buckets + 1] = {};
+    size_t next[buckets] = {};
+    size_t order[Count] = {};
+    bool used[slots] = {};
+    for (size_t i = 0; i < slots; i++) {
+      this->table[i] = 0;
+    }
+    for (size_t i = 0; i < Count; i++) {
+      hashes[i] = hash(this->names[i], seed);
+      start[bucket(hashes[i]) + 1]++;
+    }
+    size_t largest = 0;
+    for (size_t b = 0; b < buckets; b++) {
+      largest = start[b + 1] > largest ? start[b + 1] : largest;
+      start[b + 1] += start[b];
+      next[b] = start[b];
+    }
+    for (size_t i = 0; i < Count; i++) {
+      order[next[bucket(hashes[i])]++] = i;
+    }
+    // Larger buckets are harder to place, so they go while there's room
+    for (size_t size = largest; size > 0; size--) {
+      for (size_t b = 0; b < buckets; b++) {
+        if (start[b + 1] - start[b] != size) {
+          continue;
+        }
+        // Names with the same low bits can't be displaced apart; only
+        // duplicates (which are caught here) collide for every seed.
+        for (size_t j = start[b]; j < start[b + 1]; j++) {
+          for (size_t k = start[b]; k < j; k++) {
+            if (slot(hashes[order[j]], 0) == slot(hashes[order[k]], 0)) {
+              if (same(this->names[order[j]], this->names[order[k]])) {
+                throw std::invalid_argument("duplicate name");
+              }
+              return false;
+            }
+          }
+        }
+        size_t displacement = 0;
+        while (!fits(hashes, order + start[b], size, displacement, used)) {
+          if (++displacement == slots) {
+            return false;
+          }
+        }
+        this->displacements[b] = displacement;
+        for (size_t j = 0; j < size; j++) {
+          size_t i = order[start[b] + j];
+          used[slot(hashes[i], displacement)] = true;
+          this->table[slot(hashes[i], displacement)] = i;
+        }
+      }
+    }
+    return true;
+  }
+
+  // Whether a bucket's names all land in free slots; they're already in
+  // different ones, since XOR with the same displacement keeps them apart.
+  static constexpr bool fits(const uint64_t *hashes, const size_t *members,
+                             size_t size, size_t displacement,
+                             const bool *used) {
+    for (size_t j = 0; j < size; j++) {
+      if (used[slot(hashes[members[j]], displacement)]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static constexpr uint64_t mix(uint64_t h, uint64_t word) {
+    h = (h ^ word) * 0x9E3779B97F4A7C15ULL;
+    return h ^ (h >> 32);
+  }
+
+  // Multiplying only carries upwards, so names that differ only in their
+  // last word (QJOBMSGQFL, QJOBMSGQMX) would share their low bits, and
+  // with them, slots; this spreads the whole hash over every bit.
+  static constexpr uint64_t finish(uint64_t h) {
+    h = (h ^ (h >> 33)) * 0xFF51AFD7ED558CCDULL;
+    h = (h ^ (h >> 33)) * 0xC4CEB9FE1A85EC53ULL;
+    return h ^ (h >> 33);
+  }
+
+  // Hashes the field as big-endian words, zero-padded at the end; this one
+  // puts them together a byte at a time, so it works at compile time.
+  static constexpr uint64_t hash(const char *field, uint64_t seed) {
+    uint64_t h = seed;
+    for (size_t i = 0; i < Len; i += 8) {
+      uint64_t word = 0;
+      for (size_t j = i; j < i + 8; j++) {
+        word = word << 8 | (j < Len ? (unsigned char)field[j] : 0);
+      }
+      h = mix(h, word);
+    }
+    return finish(h);
+  }
+
+  // The same hash with word loads, for runtime.
+  static uint64_t hash_words(const char *field, uint64_t seed) {
+    uint64_t h = seed;
+    for (size_t i = 0; i < Len; i += 8) {
+      uint64_t word = 0;
+      memcpy(&word, field + i, Len - i < 8 ? Len - i : 8);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+      word = __builtin_bswap64(word);
+#endif
+      h = mix(h, word);
+    }
+    return finish(h);
+  }
+
+  static constexpr bool same(const char *a, const char *b) {
+    for (size_t i = 0; i < Len; i++) {
+      if (a[i] != b[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  char names[Count][Len];
+  size_t table[slots];
+  size_t displacements[buckets];
+  uint64_t seed;
+};
+
+template <size_t Len, size_t Count>
+constexpr size_t EbcdicNameSet<Len, Count>::npos;
+
+/**
+ * Build an EbcdicNameSet of Len byte fields from ASCII names.
+ */
+template <size_t Len, typename... Names>
+constexpr EbcdicNameSet<Len, sizeof...(Names)>
+ebcdic_names(const Names &... names) {
+  return EbcdicNameSet<Len, sizeof...(Names)>({names...});
+}
+
 } // namespace pase_cpp
@@ -56,16 +56,11 @@ static auto Qp0lCvtPathToQSYSObjName =
                 unsigned int, Qus_EC_t *>("QSYS/QP0LLIB2",
                                           "Qp0lCvtPathToQSYSObjName");
 
-iconv_t to_37, from_37;
-
-static void to_ascii(char *ebcdic, size_t ebcdic_size, char *ascii,
-                     size_t ascii_out) {
-  const char *ascii_begin = ascii;
-  iconv(from_37, &ebcdic, &ebcdic_size, &ascii, &ascii_out);
-  // Trim spaces
-  while (ascii >= ascii_begin && *(ascii - 1) == ' ') {
-    *ascii-- = '\0';
-  }
+iconv_t to_37;
+
+// Object names are invariant characters, no need for iconv
+static void to_ascii(char *ebcdic, size_t ebcdic_size, char *ascii) {
+  ascii[e2a_trim(ascii, ebcdic, ebcdic_size)] = '\0';
 }
 
 static void print_qsys(const char *path) {
@@ -92,20 +87,15 @@ static void print_qsys(const char *path) {
                            37, &err);
   if (err.Exception_Id[0] != '\0') {
     char exception_id[8];
-    in = (char *)err.Exception_Id;
-    inleft = 7;
-    out = exception_id;
-    outleft = 8;
-    iconv(from_37, &in, &inleft, &out, &outleft);
+    to_ascii(err.Exception_Id, 7, exception_id);
     fprintf(stderr, "Failed to convert %s: %s\n", path, exception_id);
     return;
   }
 
-  // Handle worst case UTF-8 conversion
-  char lib_name[60], obj_name[60], mbr_name[60];
-  to_ascii(qsys.lib_name, 10, lib_name, 60);
-  to_ascii(qsys.obj_name, 10, obj_name, 60);
-  to_ascii(qsys.mbr_name, 10, mbr_name, 60);
+  char lib_name[11], obj_name[11], mbr_name[11];
+  to_ascii(qsys.lib_name, 10, lib_name);
+  to_ascii(qsys.obj_name, 10, obj_name);
+  to_ascii(qsys.mbr_name, 10, mbr_name);
   if (strlen(mbr_name) > 0) {
     printf("%s: %s/%s(%s)\n", path, lib_name, obj_name, mbr_name);
   } else {
@@ -115,7 +105,6 @@ static void print_qsys(const char *path) {
 
 int main(int argc, char **argv) {
   to_37 = iconv_open(ccsidtocs(37), ccsidtocs(Qp2paseCCSID()));
-  from_37 = iconv_open(ccsidtocs(Qp2paseCCSID()), ccsidtocs(37));
 
   for (int i = 1; i < argc; i++) {
     print_qsys(argv[i]);
@@ -46,5 +46,9 @@ int main(void) {
   f(&example1, 42); // not example1 = f(42);
   printf("struct 1: %lld %lld %lld %lld %lld\n", example1.a, example1.b,
          example1.c, example1.d, example1.e);
+  // or returned in place, in a slot that lives as long as the handle
+  auto example2 = f(43);
+  printf("struct 2: %lld %lld %lld %lld %lld\n", example2->a, example2->b,
+         example2->c, example2->d, example2->e);
   return 0;
 }
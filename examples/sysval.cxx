@@ -5,6 +5,7 @@
  * SPDX-License-Identifier: ISC
  */
  
+#include <cstddef>
 #include <cstdio>
 #include <cstring>
 #include <string>
@@ -16,6 +17,7 @@ extern "C" {
 
 #include "ebcdic.hxx"
 #include "pgmfunc.hxx"
+#include "records.hxx"
 
 using namespace pase_cpp;
 
@@ -40,6 +42,11 @@ typedef struct Qwc_Rsval_Data_Rtnd {
   /*Qwc_Rsval_Sys_Value_Table_t System_Values[];*/ /* Varying length */
 } Qwc_Rsval_Data_Rtnd_t;
 
+using SysvalTable =
+    OffsetTableView<Qwc_Rsval_Data_Rtnd_t, Qwc_Rsval_Sys_Value_Table_t,
+                    offsetof(Qwc_Rsval_Data_Rtnd_t, Number_Sys_Vals_Rtnd),
+                    offsetof(Qwc_Rsval_Data_Rtnd_t, Offset_Sys_Val_Table)>;
+
 static auto QWCRSVAL =
     PGMFunction<void *, int, int, char *, Qus_EC_t *>("QSYS", "QWCRSVAL");
 
@@ -50,24 +57,48 @@ static void to_ascii(char *ebcdic, size_t ebcdic_size, char *ascii,
   iconv(from_37, &ebcdic, &ebcdic_size, &ascii, &ascii_out);
 }
 
-static void print_sysval(Qwc_Rsval_Sys_Value_Table *sysval) {
-  char name[60] = {};
-  to_ascii(sysval->System_Value, 10, name, 60);
+// System values that are lists of 10 character names
+static constexpr auto name_lists = ebcdic_names<10>("QSYSLIBL", "QUSRLIBL");
+
+static void print_names(const char *name, const char *data, int length) {
+  printf("%s:", name);
+  for (int i = 0; i + 10 <= length && !ebcdic_blank(data + i, 10); i += 10) {
+    char entry[10];
+    size_t entry_length = e2a_trim(entry, data + i, sizeof(entry));
+    printf(" %.*s", (int)entry_length, entry);
+  }
+  printf("\n");
+}
+
+static void print_sysval(RecordView<Qwc_Rsval_Sys_Value_Table_t> sysval) {
+  // Not converted; names are invariant characters, so printing one only
+  // needs e2a, not iconv
+  EbcdicView name = sysval.ebcdic(&Qwc_Rsval_Sys_Value_Table_t::System_Value);
+  const char *data = sysval.bytes(offsetof(Qwc_Rsval_Sys_Value_Table_t, Data),
+                                  sysval->Length_Data);
 
   if (sysval->Information_Status == 'L'_e) {
-    fprintf(stderr, "%s: locked\n", name);
+    fprintf(stderr, "%s: locked\n", name.str().c_str());
     return;
   }
 
   if (sysval->Type_Data != 'C'_e) {
-    fprintf(stderr, "%s: not a string\n", name);
+    fprintf(stderr, "%s: not a string\n", name.str().c_str());
+    return;
+  }
+
+  // Dispatch on the name without converting it
+  switch (name_lists.find(name)) {
+  case name_lists.index("QSYSLIBL"):
+  case name_lists.index("QUSRLIBL"):
+    print_names(name.str().c_str(), data, sysval->Length_Data);
     return;
   }
 
   auto out = std::string(sysval->Length_Data * 6, '\0');
-  to_ascii(sysval->Data, sysval->Length_Data, (char *)out.data(),
+  to_ascii((char *)data, sysval->Length_Data, (char *)out.data(),
            out.capacity());
-  printf("%s: %s\n", name, out.c_str());
+  printf("%s: %s\n", name.str().c_str(), out.c_str());
 }
 
 int main(int argc, char **argv) {
@@ -108,10 +139,8 @@ int main(int argc, char **argv) {
     return 1;
   }
 
-  Qwc_Rsval_Data_Rtnd_t *returned = (Qwc_Rsval_Data_Rtnd_t *)buffer;
-  for (int i = 0; i < returned->Number_Sys_Vals_Rtnd; i++) {
-    int offset = returned->Offset_Sys_Val_Table[i];
-    print_sysval((Qwc_Rsval_Sys_Value_Table_t *)(buffer + offset));
+  for (auto sysval : SysvalTable(buffer, sizeof(buffer))) {
+    print_sysval(sysval);
   }
 
   return 0;
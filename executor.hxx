@@ -0,0 +1,137 @@
+// vim: expandtab:ts=2:sw=2
+/*
+ * Copyright (c) 2025 Seiden Group
+ *
+ * SPDX-License-Identifier: ISC
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace pase_cpp {
+
+/*
+ * Runs ILEFunction/PGMFunction calls (or anything callable) on a pool of
+ * worker threads, so slow calls don't block the caller. Each call returns a
+ * std::future; exceptions thrown by the call, i.e. an MI exception when
+ * calling with ILECALL_EXCP_NOSIGNAL, are rethrown from the future's get.
+ *
+ * The wrappers are safe to call from several workers at once; activation
+ * is shared and done once, by whichever worker calls first. Flags for a
+ * single call are passed through as ILECallFlags/PGMCallFlags arguments.
+ */
+class CallExecutor {
+public:
+  /**
+   * Start threads workers; at most that many calls run at once. If
+   * max_queued isn't 0, submit blocks while that many calls are waiting
+   * for a worker, instead of queueing without bound.
+   */
+  explicit CallExecutor(size_t threads, size_t max_queued = 0) {
+    if (threads == 0) {
+      throw std::invalid_argument("at least one worker is needed");
+    }
+    this->max_queued = max_queued;
+    this->stopping = false;
+    try {
+      for (size_t i = 0; i < threads; i++) {
+        this->workers.emplace_back([this]() { this->work(); });
+      }
+    } catch (...) {
+      // Joinable threads can't be destroyed
+      this->stop();
+      throw;
+    }
+  }
+
+  CallExecutor(const CallExecutor &) = delete;
+  CallExecutor &operator=(const CallExecutor &) = delete;
+
+  /**
+   * Waits for queued calls to finish.
+   */
+  ~CallExecutor() { this->stop(); }
+
+  /**
+   * Queue a call of function with args. Arguments are copied, like they
+   * would be for calling the wrapper directly; pointer arguments must stay
+   * valid until the call is done. If function is an lvalue, like a wrapper,
+   * it's called by reference and must outlive the call; otherwise, i.e. a
+   * lambda, it's moved into the queue.
+   */
+  template <typename TFunction, typename... Args>
+  auto submit(TFunction &&function, Args... args)
+      -> std::future<decltype(function(args...))> {
+    using TReturn = decltype(function(args...));
+    using THeld = std::conditional_t<
+        std::is_lvalue_reference<TFunction>::value,
+        std::reference_wrapper<std::remove_reference_t<TFunction>>,
+        std::decay_t<TFunction>>;
+    // std::function needs to be copyable, packaged_task isn't
+    auto task = std::make_shared<std::packaged_task<TReturn()>>(
+        std::bind(THeld(std::forward<TFunction>(function)), args...));
+    auto future = task->get_future();
+    {
+      std::unique_lock<std::mutex> lock(this->mutex);
+      this->queue_space.wait(lock, [this]() {
+        return this->max_queued == 0 || this->queue.size() < this->max_queued;
+      });
+      this->queue.emplace_back([task]() { (*task)(); });
+    }
+    this->queue_ready.notify_one();
+    return future;
+  }
+
+private:
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      this->stopping = true;
+    }
+    this->queue_ready.notify_all();
+    for (auto &worker : this->workers) {
+      worker.join();
+    }
+  }
+
+  void work() {
+    for (;;) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->queue_ready.wait(lock, [this]() {
+          return this->stopping || !this->queue.empty();
+        });
+        if (this->queue.empty()) {
+          return;
+        }
+        task = std::move(this->queue.front());
+        this->queue.pop_front();
+      }
+      this->queue_space.notify_one();
+      // packaged_task catches anything thrown for the future
+      task();
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable queue_ready, queue_space;
+  std::deque<std::function<void()>> queue;
+  std::vector<std::thread> workers;
+  size_t max_queued;
+  bool stopping;
+};
+
+} // namespace pase_cpp
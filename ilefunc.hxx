@@ -9,19 +9,29 @@
 
 extern "C" {
 #include <as400_protos.h>
-#include <unistd.h>
+#include <pthread.h>
 }
 
 #include <array>
+#include <atomic>
 #include <cstdlib>
 #include <cstring>
+#include <initializer_list>
+#include <mutex>
 #include <stdexcept>
 #include <string>
+#include <tuple>
 #include <type_traits>
+#include <unordered_map>
+#include <utility>
 #if !defined(__cpp_lib_logical_traits)
 #include <experimental/type_traits> // just assume for GCC 6, no polyfill
 #endif
 
+#include "ilepointer.hxx"
+#include "instrument.hxx"
+#include "results.hxx"
+
 namespace pase_cpp {
 
 #if defined(__cpp_lib_logical_traits)
@@ -150,8 +160,10 @@ public:
   static constexpr arg_type_t type() { return ARG_MEMPTR; }
 
   static inline void write(char *dst, T *src) {
-    // The high word should be unset as it's initialized in ctor
+    // Write all 16 bytes, not just the address; a reused arglist may have
+    // had the slot converted in place by _ILECALLX.
     ILEpointer *p = (ILEpointer *)dst;
+    memset(p, 0, sizeof(*p));
     p->s.addr = (address64_t)src;
   }
 };
@@ -169,6 +181,12 @@ public:
     write<0>(args...);
   }
 
+  explicit ILEArglist(const std::tuple<TArgs...> &args) {
+    this->base = {};
+    this->arguments = {};
+    set(args);
+  }
+
   static constexpr auto offsets() {
     auto sizes = Sizes{ILEArgument<TArgs>::align()...};
     auto offsets = Sizes();
@@ -198,53 +216,229 @@ public:
     return sizes_c.back() + offsets_c.back();
   }
 
+  /**
+   * Clear what the last call left in base (the result), for reusing the
+   * arglist across calls.
+   */
+  void reset() { this->base = {}; }
+
+  /**
+   * Overwrite one argument in place, for reusing the arglist across calls.
+   * The whole slot is rewritten, pointers included.
+   */
+  template <size_t index>
+  void set(std::tuple_element_t<index, std::tuple<TArgs...>> argument) {
+    using T = std::tuple_element_t<index, std::tuple<TArgs...>>;
+    constexpr size_t offset = std::get<index>(offsets());
+    ILEArgument<T>::write(this->arguments.data() + offset, argument);
+  }
+
+  /**
+   * Overwrite all arguments in place from a tuple.
+   */
+  void set(const std::tuple<TArgs...> &args) {
+    set(args, std::index_sequence_for<TArgs...>());
+  }
+
   __attribute__((aligned(16))) ILEarglist_base base;
   __attribute__((aligned(16))) std::array<char, size()> arguments;
 
 private:
+  template <size_t... indices>
+  void set(const std::tuple<TArgs...> &args, std::index_sequence<indices...>) {
+    // Pack expansion in an initializer list is ordered; no fold in C++14
+    (void)std::initializer_list<int>{
+        (set<indices>(std::get<indices>(args)), 0)...};
+  }
+
   template <size_t index> void write() {}
 
   template <size_t index, typename T, typename... Ts>
   void write(T argument, Ts... rest) {
-    ILEArgument<T>::write(this->arguments.data() + offsets()[index], argument);
+    set<index>(argument);
     write<index + 1>(rest...);
   }
 };
 
+/*
+ * Where results go in ILEFunction::call_batch: structures are written in
+ * place by the call, fundamental types are copied out after, void is
+ * dropped.
+ */
+template <typename T, bool aggregate = (ILEArgument<T>::result_type() > 0)>
+struct ILEBatchResult {
+  static void prepare(ILEarglist_base *base, T *results, size_t i) {
+    base->result.r_aggregate.s.addr = (address64_t)(results + i);
+  }
+  static void store(ILEarglist_base *, T *, size_t) {}
+};
+template <typename T> struct ILEBatchResult<T, false> {
+  static void prepare(ILEarglist_base *, T *, size_t) {}
+  static void store(ILEarglist_base *base, T *results, size_t i) {
+    results[i] = ILEArgument<T>::base_return(base);
+  }
+};
+template <> struct ILEBatchResult<void, false> {
+  static void prepare(ILEarglist_base *, void *, size_t) {}
+  static void store(ILEarglist_base *, void *, size_t) {}
+};
+
+// See PASE_CPP_ABI in instrument.hxx
+inline namespace PASE_CPP_ABI {
+
+/**
+ * Process-wide cache of activated service programs and resolved procedures,
+ * so wrapping many procedures (or the same one many times) only activates a
+ * service program once, and resolves each symbol once.
+ *
+ * Activation marks and procedure pointers don't survive a fork, so the
+ * cache has a generation that's bumped in the child by pthread_atfork.
+ * Callers remember the generation they resolved in, and come back when it
+ * changes; the cache then reactivates and resolves again.
+ */
+class ILESymbolCache {
+  using ActivationMark = unsigned long long;
+
+  struct Activation {
+    ActivationMark mark;
+    unsigned long generation;
+  };
+
+  struct Procedure {
+    ILEpointer *pointer;
+    unsigned long generation;
+  };
+
+public:
+  static ILESymbolCache &instance() {
+    static ILESymbolCache cache;
+    return cache;
+  }
+
+  /**
+   * The current generation; cheap, so this can be checked on every call.
+   */
+  static unsigned long generation() {
+    return generation_counter().load(std::memory_order_acquire);
+  }
+
+  /**
+   * Activate the service program if needed, and resolve the procedure in
+   * it if needed. The pointer returned stays valid for the life of the
+   * process; its contents are valid for the generation returned in out.
+   * When instrumented, the time spent activating and resolving (not
+   * finding them in the cache) is counted for stats_site.
+   */
+  const ILEpointer *resolve(const std::string &path, const std::string &symbol,
+                            unsigned long *resolved_generation,
+                            size_t stats_site = (size_t)-1) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    const unsigned long current = generation();
+    Procedure &procedure = this->procedures[path + '\0' + symbol];
+    if (procedure.pointer != nullptr && procedure.generation == current) {
+      *resolved_generation = current;
+      return procedure.pointer;
+    }
+#if defined(PASE_CPP_INSTRUMENT)
+    uint64_t begin = CallStatsRegistry::now();
+#else
+    (void)stats_site;
+#endif
+    Activation &activation = this->activations[path];
+    if (activation.generation != current) {
+      activation.mark = _ILELOADX(path.c_str(), ILELOAD_LIBOBJ);
+      if (activation.mark == (ActivationMark)-1) {
+        throw std::invalid_argument("invalid service program");
+      }
+      activation.generation = current;
+    }
+    if (procedure.pointer == nullptr) {
+      procedure.pointer = allocate_ile_pointer();
+    }
+    if (_ILESYMX(procedure.pointer, activation.mark, symbol.c_str()) !=
+        ILESYM_PROCEDURE) {
+      throw std::invalid_argument("invalid symbol");
+    }
+#if defined(PASE_CPP_INSTRUMENT)
+    CallStatsRegistry::record_activation(stats_site,
+                                         CallStatsRegistry::now() - begin);
+#endif
+    procedure.generation = current;
+    *resolved_generation = current;
+    return procedure.pointer;
+  }
+
+private:
+  ILESymbolCache() {
+    // Hold the lock over fork, so the child doesn't inherit it locked by
+    // a thread that doesn't exist there.
+    pthread_atfork(
+        []() { instance().mutex.lock(); }, []() { instance().mutex.unlock(); },
+        []() {
+          generation_counter().fetch_add(1, std::memory_order_acq_rel);
+          instance().mutex.unlock();
+        });
+  }
+
+  static std::atomic<unsigned long> &generation_counter() {
+    // Starts at 1, so 0 can mean never resolved
+    static std::atomic<unsigned long> counter(1);
+    return counter;
+  }
+
+  std::mutex mutex;
+  std::unordered_map<std::string, Activation> activations;
+  std::unordered_map<std::string, Procedure> procedures;
+};
+
+/**
+ * Flags for a single call of an ILEFunction, passed before the arguments,
+ * instead of the ones it was constructed with.
+ */
+struct ILECallFlags {
+  int flags;
+};
+
+template <typename TReturn, typename... TArgs> class ILEBoundCall;
+
 template <typename TReturn, typename... TArgs> class ILEFunction {
   static_assert(ParameterPackContains<void, TArgs...>::value == false,
                 "Argument list must not contain void (use no args instead)");
   static_assert(sizeof...(TArgs) <= 400, "_ILECALL maximum arguments reached");
 
-  using ActivationMark = unsigned long long;
-
 public:
   ILEFunction(const char *path, const char *symbol, int flags = 0) {
-    this->my_pid = -1;
-    this->activation_mark = -1;
-    this->procedure = {};
+    this->generation = 0;
+    this->procedure = nullptr;
     // Invalid flags will result in... ILECALL_INVALID_FLAGS
     this->flags = flags & (ILECALL_NOINTERRUPT | ILECALL_EXCP_NOSIGNAL);
     this->path = path;
     this->symbol = symbol;
     this->signature = {ILEArgument<TArgs>::type()..., ARG_END};
+#if defined(PASE_CPP_INSTRUMENT)
+    this->stats_site = CallStatsRegistry::instance().site(this->path + "(" +
+                                                          this->symbol + ")");
+#endif
   }
 
-  void init() {
-    // Forking will destroy the activation mark
-    pid_t current_pid = getpid();
-    if (this->my_pid == current_pid) {
-      return;
+  const ILEpointer *init() {
+    // Forking will destroy the activation mark; the generation changes then.
+    // Racing threads will get the same pointer from the cache, so it's OK.
+    if (__atomic_load_n(&this->generation, __ATOMIC_ACQUIRE) ==
+        ILESymbolCache::generation()) {
+      return __atomic_load_n(&this->procedure, __ATOMIC_RELAXED);
     }
-    this->activation_mark = _ILELOADX(this->path.c_str(), ILELOAD_LIBOBJ);
-    if (this->activation_mark == (ActivationMark)-1) {
-      throw std::invalid_argument("invalid service program");
-    }
-    if (_ILESYMX(&this->procedure, this->activation_mark,
-                 this->symbol.c_str()) != ILESYM_PROCEDURE) {
-      throw std::invalid_argument("invalid symbol");
-    }
-    this->my_pid = current_pid;
+    unsigned long resolved_generation;
+#if defined(PASE_CPP_INSTRUMENT)
+    const ILEpointer *resolved = ILESymbolCache::instance().resolve(
+        this->path, this->symbol, &resolved_generation, this->stats_site);
+#else
+    const ILEpointer *resolved = ILESymbolCache::instance().resolve(
+        this->path, this->symbol, &resolved_generation);
+#endif
+    __atomic_store_n(&this->procedure, resolved, __ATOMIC_RELAXED);
+    __atomic_store_n(&this->generation, resolved_generation, __ATOMIC_RELEASE);
+    return resolved;
   }
 
   /**
@@ -256,9 +450,16 @@ public:
             typename = typename std::enable_if_t<
                 (ILEArgument<TReturnInner>::result_type() <= 0)>>
   TReturnInner operator()(TArgs... args) {
+    return (*this)(ILECallFlags{this->flags}, args...);
+  }
+
+  template <typename TReturnInner = TReturn,
+            typename = typename std::enable_if_t<
+                (ILEArgument<TReturnInner>::result_type() <= 0)>>
+  TReturnInner operator()(ILECallFlags flags, TArgs... args) {
     // can just be ILEArglist(args...) in C++17
     auto arguments = ILEArglist<TArgs...>(args...);
-    this->call(&arguments.base);
+    this->call(&arguments.base, flags.flags);
     // XXX: Tagged pointers
     return ILEArgument<TReturnInner>::base_return(&arguments.base);
   }
@@ -272,20 +473,165 @@ public:
             typename = typename std::enable_if_t<
                 (ILEArgument<TReturnInner>::result_type() > 0)>>
   void operator()(TReturnInner *ret, TArgs... args) {
+    (*this)(ILECallFlags{this->flags}, ret, args...);
+  }
+
+  template <typename TReturnInner = TReturn,
+            typename = typename std::enable_if_t<
+                (ILEArgument<TReturnInner>::result_type() > 0)>>
+  void operator()(ILECallFlags flags, TReturnInner *ret, TArgs... args) {
     auto arguments = ILEArglist<TArgs...>(args...);
     arguments.base.result.r_aggregate.s.addr = (address64_t)ret;
-    this->call(&arguments.base);
+    this->call(&arguments.base, flags.flags);
+  }
+
+  /**
+   * Call the ILE function, returning the structure in a slot from this
+   * thread's ResultArena, where it was written; see ILEResult.
+   */
+  template <typename TReturnInner = TReturn,
+            typename std::enable_if_t<
+                (ILEArgument<TReturnInner>::result_type() > 0), int> = 0>
+  ILEResult<TReturnInner> operator()(TArgs... args) {
+    return (*this)(ILECallFlags{this->flags}, args...);
+  }
+
+  template <typename TReturnInner = TReturn,
+            typename std::enable_if_t<
+                (ILEArgument<TReturnInner>::result_type() > 0), int> = 0>
+  ILEResult<TReturnInner> operator()(ILECallFlags flags, TArgs... args) {
+    ILEResult<TReturnInner> result;
+    (*this)(flags, result.get(), args...);
+    return result;
+  }
+
+  /**
+   * Call the ILE function once for each of count argument tuples, storing
+   * each return value in results. For structures, results are where each
+   * return is written to. The _ILECALLX return code of each call is stored
+   * in status, if it isn't null, instead of throwing. Returns the number
+   * of calls that didn't return 0.
+   *
+   * Batches always call with ILECALL_EXCP_NOSIGNAL, so an MI exception is
+   * stored as -1 for that call, instead of signalling partway through.
+   * Activation is only checked once, and only that can throw.
+   */
+  template <typename TReturnInner = TReturn,
+            typename = typename std::enable_if_t<
+                false == std::is_void<TReturnInner>::value>>
+  size_t call_batch(const std::tuple<TArgs...> *args, size_t count,
+                    TReturnInner *results, int *status = nullptr) {
+    return this->batch(args, count, results, status);
+  }
+
+  /**
+   * Like call_batch above, for structures, with results returned in
+   * contiguous slots from this thread's ResultArena; see ILEResults.
+   */
+  template <typename TReturnInner = TReturn,
+            typename = typename std::enable_if_t<
+                (ILEArgument<TReturnInner>::result_type() > 0)>>
+  size_t call_batch(const std::tuple<TArgs...> *args, size_t count,
+                    ILEResults<TReturnInner> &results,
+                    int *status = nullptr) {
+    results = ILEResults<TReturnInner>(count);
+    return this->batch(args, count, results.data(), status);
+  }
+
+  /**
+   * Like call_batch above, for functions returning void.
+   */
+  template <typename TReturnInner = TReturn,
+            typename = typename std::enable_if_t<
+                std::is_void<TReturnInner>::value>>
+  size_t call_batch(const std::tuple<TArgs...> *args, size_t count,
+                    int *status = nullptr) {
+    return this->batch(args, count, (TReturnInner *)nullptr, status);
+  }
+
+  /**
+   * Build the arglist once, for calling repeatedly with ILEBoundCall.
+   */
+  ILEBoundCall<TReturn, TArgs...> bind(TArgs... args) {
+    return ILEBoundCall<TReturn, TArgs...>(*this, args...);
   }
 
 private:
-  void call(ILEarglist_base *base) {
+  friend class ILEBoundCall<TReturn, TArgs...>;
+
+  template <typename TReturnInner>
+  size_t batch(const std::tuple<TArgs...> *args, size_t count,
+               TReturnInner *results, int *status) {
+    if (count == 0) {
+      return 0;
+    }
+    const ILEpointer *procedure = this->init();
+    auto arguments = ILEArglist<TArgs...>(args[0]);
+    const int flags = this->flags | ILECALL_EXCP_NOSIGNAL;
+    size_t failed = 0;
+    for (size_t i = 0; i < count; i++) {
+      arguments.reset();
+      arguments.set(args[i]);
+      ILEBatchResult<TReturnInner>::prepare(&arguments.base, results, i);
+      int rc = this->call(procedure, &arguments.base, flags);
+      if (rc == 0) {
+        ILEBatchResult<TReturnInner>::store(&arguments.base, results, i);
+      } else {
+        failed++;
+      }
+      if (status != nullptr) {
+        status[i] = rc;
+      }
+    }
+    return failed;
+  }
+
+  int call(const ILEpointer *procedure, ILEarglist_base *base, int flags) {
+    // Invalid flags will result in... ILECALL_INVALID_FLAGS
+    flags &= ILECALL_NOINTERRUPT | ILECALL_EXCP_NOSIGNAL;
+#if defined(PASE_CPP_INSTRUMENT)
+    uint64_t begin = CallStatsRegistry::now();
+#endif
+    int rc = _ILECALLX(procedure, base, this->signature.data(),
+                       ILEArgument<TReturn>::result_type(), flags);
+#if defined(PASE_CPP_INSTRUMENT)
+    CallStatsRegistry::record_call(this->stats_site,
+                                   CallStatsRegistry::now() - begin,
+                                   call_result(rc));
+#endif
+    return rc;
+  }
+
+#if defined(PASE_CPP_INSTRUMENT)
+  static CallResult call_result(int rc) {
+    switch (rc) {
+    case 0:
+      return CallResult::ok;
+    case -1:
+      return CallResult::exception;
+    case ILECALL_INVALID_ARG:
+      return CallResult::invalid_argument;
+    case ILECALL_INVALID_RESULT:
+      return CallResult::invalid_result;
+    case ILECALL_INVALID_FLAGS:
+      return CallResult::invalid_flags;
+    default:
+      return CallResult::other;
+    }
+  }
+#endif
+
+  void call(ILEarglist_base *base) { this->call(base, this->flags); }
+
+  void call(ILEarglist_base *base, int flags) {
     // Lazy initialization (and reinit), throws
-    this->init();
-    int rc = _ILECALLX(&this->procedure, base, this->signature.data(),
-                       ILEArgument<TReturn>::result_type(), this->flags);
+    int rc = this->call(this->init(), base, flags);
     // 0 is OK, -1 w/ errno 3474 is an MI exception, positive is _ILECALL error
-    // These shouldn't happen with our wrapper around it.
-    if (rc == ILECALL_INVALID_ARG) {
+    // The latter shouldn't happen with our wrapper around it.
+    if (rc == -1) {
+      // Only returned instead of signalled with ILECALL_EXCP_NOSIGNAL
+      throw std::runtime_error("MI exception");
+    } else if (rc == ILECALL_INVALID_ARG) {
       throw std::invalid_argument("invalid signature");
     } else if (rc == ILECALL_INVALID_RESULT) {
       throw std::invalid_argument("invalid result");
@@ -294,12 +640,82 @@ private:
     }
   }
 
-  ActivationMark activation_mark;
-  pid_t my_pid;
+  // Owned by ILESymbolCache
+  const ILEpointer *procedure;
+  unsigned long generation;
   int flags;
-  ILEpointer procedure __attribute__((aligned(16)));
   std::string path, symbol;
   std::array<arg_type_t, sizeof...(TArgs) + 1> signature;
+#if defined(PASE_CPP_INSTRUMENT)
+  size_t stats_site;
+#endif
+};
+
+/**
+ * A call to an ILEFunction with its arglist already built, for calling the
+ * same function in a loop. Arguments stay in place between calls, so only
+ * the ones that change need to be set again; this avoids zeroing and
+ * rebuilding the whole arglist on every call. Before each call, base is
+ * zeroed again (and r_aggregate set for structures), so nothing _ILECALLX
+ * left in it is passed back; argument slots are only rewritten by set.
+ *
+ * This holds a reference to the ILEFunction, which must outlive it.
+ */
+template <typename TReturn, typename... TArgs> class ILEBoundCall {
+public:
+  ILEBoundCall(ILEFunction<TReturn, TArgs...> &function, TArgs... args)
+      : function(&function), arguments(args...) {}
+
+  /**
+   * Replace the argument at index for the next calls.
+   */
+  template <size_t index>
+  void set(std::tuple_element_t<index, std::tuple<TArgs...>> argument) {
+    this->arguments.template set<index>(argument);
+  }
+
+  /**
+   * Call the ILE function with the current arguments.
+   *
+   * This overload is used for fundamental (void/arith) types.
+   */
+  template <typename TReturnInner = TReturn,
+            typename = typename std::enable_if_t<
+                (ILEArgument<TReturnInner>::result_type() <= 0)>>
+  TReturnInner operator()() {
+    this->arguments.reset();
+    this->function->call(&this->arguments.base);
+    return ILEArgument<TReturnInner>::base_return(&this->arguments.base);
+  }
+
+  /**
+   * Call the ILE function with the current arguments.
+   *
+   * This overload is used for structures, due to limitations of NRVO.
+   */
+  template <typename TReturnInner = TReturn,
+            typename = typename std::enable_if_t<
+                (ILEArgument<TReturnInner>::result_type() > 0)>>
+  void operator()(TReturnInner *ret) {
+    this->arguments.reset();
+    this->arguments.base.result.r_aggregate.s.addr = (address64_t)ret;
+    this->function->call(&this->arguments.base);
+  }
+
+  template <typename TReturnInner = TReturn,
+            typename std::enable_if_t<
+                (ILEArgument<TReturnInner>::result_type() > 0), int> = 0>
+  ILEResult<TReturnInner> operator()() {
+    ILEResult<TReturnInner> result;
+    (*this)(result.get());
+    return result;
+  }
+
+private:
+  ILEFunction<TReturn, TArgs...> *function;
+  ILEArglist<TArgs...> arguments;
 };
 
+} // inline namespace PASE_CPP_ABI
+
 } // namespace pase_cpp
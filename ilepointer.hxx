@@ -0,0 +1,32 @@
+// vim: expandtab:ts=2:sw=2
+/*
+ * Copyright (c) 2025 Seiden Group
+ *
+ * SPDX-License-Identifier: ISC
+ */
+
+#pragma once
+
+extern "C" {
+#include <as400_protos.h>
+}
+
+#include <cstdlib>
+#include <new>
+
+namespace pase_cpp {
+
+/**
+ * A zeroed ILEpointer of its own, for an API like _ILESYMX or _RSLOBJ2 to
+ * write in place; shared by ILESymbolCache and PGMObjectCache. It's never
+ * moved or freed, since a copy loses the tag.
+ */
+inline ILEpointer *allocate_ile_pointer() {
+  void *p = nullptr;
+  if (posix_memalign(&p, 16, sizeof(ILEpointer)) != 0) {
+    throw std::bad_alloc();
+  }
+  return new (p) ILEpointer();
+}
+
+} // namespace pase_cpp
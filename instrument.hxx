@@ -0,0 +1,284 @@
+// vim: expandtab:ts=2:sw=2
+/*
+ * Copyright (c) 2025 Seiden Group
+ *
+ * SPDX-License-Identifier: ISC
+ */
+
+#pragma once
+
+/*
+ * Optional statistics for ILEFunction and PGMFunction calls: call counts,
+ * latency (total and as a histogram), activation cost, and how calls
+ * returned. Define PASE_CPP_INSTRUMENT before including the wrappers to
+ * enable it, for the whole program; otherwise, none of this is compiled in.
+ *
+ * Each thread counts into its own counters, written without locks or
+ * atomic read-modify-write; snapshot sums all threads' counters, so it's
+ * cheap enough to poll from a metrics thread.
+ */
+
+/*
+ * The wrappers' (and their caches') members and inline code depend on
+ * PASE_CPP_INSTRUMENT, so they're declared in an inline namespace named
+ * after it. Otherwise, a
+ * program built with it in some translation units and not others would
+ * have two different definitions of the same classes, and corrupt memory;
+ * this way, passing wrappers between them fails to link instead.
+ */
+#if defined(PASE_CPP_INSTRUMENT)
+#define PASE_CPP_ABI instrumented
+#else
+#define PASE_CPP_ABI uninstrumented
+#endif
+
+#if defined(PASE_CPP_INSTRUMENT)
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace pase_cpp {
+
+/**
+ * How a call returned, as counted in CallStats::results.
+ */
+enum class CallResult : size_t {
+  ok,
+  // -1, MI exception
+  exception,
+  // _ILECALLX errors
+  invalid_argument,
+  invalid_result,
+  invalid_flags,
+  other,
+  count
+};
+
+/**
+ * Totals for one wrapped function (by path and symbol, or library and
+ * object), across all threads and instances.
+ */
+struct CallStats {
+  // Bucket i counts calls that took at least 2^(i-1) ns, but less than
+  // 2^i ns; the last also counts anything longer.
+  static constexpr size_t histogram_buckets = 32;
+
+  std::string name;
+  uint64_t calls;
+  uint64_t total_ns;
+  // Calls to _ILELOADX and _ILESYMX, or _RSLOBJ2, that weren't cached
+  uint64_t activations;
+  uint64_t activation_ns;
+  std::array<uint64_t, histogram_buckets> histogram;
+  std::array<uint64_t, (size_t)CallResult::count> results;
+};
+
+class CallStatsRegistry {
+  // One thread's counters for a function. Only the owning thread writes, so
+  // relaxed loads and stores are enough, and readers never see torn values.
+  struct Counters {
+    std::atomic<uint64_t> calls, total_ns, activations, activation_ns;
+    std::array<std::atomic<uint64_t>, CallStats::histogram_buckets> histogram;
+    std::array<std::atomic<uint64_t>, (size_t)CallResult::count> results;
+
+    static void add(std::atomic<uint64_t> &counter, uint64_t n) {
+      counter.store(counter.load(std::memory_order_relaxed) + n,
+                    std::memory_order_relaxed);
+    }
+
+    static void sum(uint64_t &total, const std::atomic<uint64_t> &counter) {
+      total += counter.load(std::memory_order_relaxed);
+    }
+  };
+
+  // Allocated in chunks as sites are used, so a chunk never moves while
+  // snapshot reads it.
+  static constexpr size_t chunk_size = 64;
+  static constexpr size_t max_chunks = 64;
+
+  struct CounterChunks {
+    CounterChunks() {
+      for (auto &chunk : this->chunks) {
+        chunk.store(nullptr, std::memory_order_relaxed);
+      }
+    }
+
+    ~CounterChunks() {
+      for (auto &chunk : this->chunks) {
+        delete[] chunk.load(std::memory_order_relaxed);
+      }
+    }
+
+    const Counters *find(size_t site) const {
+      const Counters *chunk =
+          this->chunks[site / chunk_size].load(std::memory_order_acquire);
+      return chunk == nullptr ? nullptr : &chunk[site % chunk_size];
+    }
+
+    Counters &get(size_t site) {
+      auto &chunk = this->chunks[site / chunk_size];
+      Counters *counters = chunk.load(std::memory_order_relaxed);
+      if (counters == nullptr) {
+        counters = new Counters[chunk_size]();
+        chunk.store(counters, std::memory_order_release);
+      }
+      return counters[site % chunk_size];
+    }
+
+    std::array<std::atomic<Counters *>, max_chunks> chunks;
+  };
+
+  struct ThreadCounters : CounterChunks {
+    ThreadCounters() {
+      CallStatsRegistry &registry = instance();
+      std::lock_guard<std::mutex> lock(registry.mutex);
+      registry.threads.push_back(this);
+    }
+
+    // Keep the counts of exited threads in the totals
+    ~ThreadCounters() {
+      CallStatsRegistry &registry = instance();
+      std::lock_guard<std::mutex> lock(registry.mutex);
+      for (size_t site = 0; site < registry.names.size(); site++) {
+        const Counters *from = this->find(site);
+        if (from != nullptr) {
+          Counters &to = registry.retired.get(site);
+          Counters::add(to.calls, from->calls);
+          Counters::add(to.total_ns, from->total_ns);
+          Counters::add(to.activations, from->activations);
+          Counters::add(to.activation_ns, from->activation_ns);
+          for (size_t i = 0; i < from->histogram.size(); i++) {
+            Counters::add(to.histogram[i], from->histogram[i]);
+          }
+          for (size_t i = 0; i < from->results.size(); i++) {
+            Counters::add(to.results[i], from->results[i]);
+          }
+        }
+      }
+      for (auto it = registry.threads.begin(); it != registry.threads.end();
+           it++) {
+        if (*it == this) {
+          registry.threads.erase(it);
+          break;
+        }
+      }
+    }
+  };
+
+public:
+  // Returned by site when there are too many sites to count
+  static constexpr size_t no_site = (size_t)-1;
+
+  static CallStatsRegistry &instance() {
+    static CallStatsRegistry registry;
+    return registry;
+  }
+
+  /**
+   * Get the site for counting calls to name; the same name always gets the
+   * same site.
+   */
+  size_t site(const std::string &name) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    auto found = this->sites.find(name);
+    if (found != this->sites.end()) {
+      return found->second;
+    }
+    if (this->names.size() == chunk_size * max_chunks) {
+      return no_site;
+    }
+    this->sites[name] = this->names.size();
+    this->names.push_back(name);
+    return this->names.size() - 1;
+  }
+
+  static void record_call(size_t site, uint64_t ns, CallResult result) {
+    if (site == no_site) {
+      return;
+    }
+    Counters &counters = thread_counters().get(site);
+    Counters::add(counters.calls, 1);
+    Counters::add(counters.total_ns, ns);
+    Counters::add(counters.histogram[bucket(ns)], 1);
+    Counters::add(counters.results[(size_t)result], 1);
+  }
+
+  static void record_activation(size_t site, uint64_t ns) {
+    if (site == no_site) {
+      return;
+    }
+    Counters &counters = thread_counters().get(site);
+    Counters::add(counters.activations, 1);
+    Counters::add(counters.activation_ns, ns);
+  }
+
+  /**
+   * Sum the counters of every thread, for every site.
+   */
+  std::vector<CallStats> snapshot() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    std::vector<CallStats> stats(this->names.size(), CallStats());
+    for (size_t site = 0; site < this->names.size(); site++) {
+      stats[site].name = this->names[site];
+      add_to(stats[site], this->retired.find(site));
+      for (const ThreadCounters *thread : this->threads) {
+        add_to(stats[site], thread->find(site));
+      }
+    }
+    return stats;
+  }
+
+  static uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+private:
+  CallStatsRegistry() = default;
+
+  static ThreadCounters &thread_counters() {
+    static thread_local ThreadCounters counters;
+    return counters;
+  }
+
+  static size_t bucket(uint64_t ns) {
+    size_t bucket = ns == 0 ? 0 : 64 - __builtin_clzll(ns);
+    return bucket < CallStats::histogram_buckets
+               ? bucket
+               : CallStats::histogram_buckets - 1;
+  }
+
+  static void add_to(CallStats &stats, const Counters *counters) {
+    if (counters == nullptr) {
+      return;
+    }
+    Counters::sum(stats.calls, counters->calls);
+    Counters::sum(stats.total_ns, counters->total_ns);
+    Counters::sum(stats.activations, counters->activations);
+    Counters::sum(stats.activation_ns, counters->activation_ns);
+    for (size_t i = 0; i < stats.histogram.size(); i++) {
+      Counters::sum(stats.histogram[i], counters->histogram[i]);
+    }
+    for (size_t i = 0; i < stats.results.size(); i++) {
+      Counters::sum(stats.results[i], counters->results[i]);
+    }
+  }
+
+  std::mutex mutex;
+  std::unordered_map<std::string, size_t> sites;
+  std::vector<std::string> names;
+  std::vector<ThreadCounters *> threads;
+  CounterChunks retired;
+};
+
+} // namespace pase_cpp
+
+#endif
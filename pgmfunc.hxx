@@ -9,14 +9,28 @@
 
 extern "C" {
 #include <as400_protos.h>
+#include <pthread.h>
 }
 
+#include <array>
+#include <cstddef>
+#include <future>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
+#include <string>
+#include <tuple>
 #include <type_traits>
+#include <unordered_map>
+#include <utility>
 #if !defined(__cpp_lib_logical_traits)
 #include <experimental/type_traits> // just assume for GCC 6, no polyfill
 #endif
 
+#include "ilepointer.hxx"
+#include "instrument.hxx"
+
 namespace pase_cpp {
 
 #if defined(__cpp_lib_logical_traits)
@@ -55,24 +69,225 @@ template <typename T> constexpr void *ParameterArrayMember(const T *obj) {
   return ParameterArrayMember(const_cast<T *>(obj));
 }
 
+/**
+ * Flags for a single call of a PGMFunction, passed before the arguments,
+ * instead of the ones it was constructed with.
+ */
+struct PGMCallFlags {
+  int flags;
+};
+
+// See PASE_CPP_ABI in instrument.hxx
+inline namespace PASE_CPP_ABI {
+
+/**
+ * Process-wide cache of resolved programs, so duplicate wrappers of a
+ * program only resolve it once. Unlike ILE activations, system pointers
+ * survive forks, so nothing is invalidated.
+ *
+ * Each program has its own lock, so different programs can be resolved at
+ * the same time (i.e. by prewarm), but a program is only resolved once.
+ */
+class PGMObjectCache {
+  struct Program {
+    std::mutex mutex;
+    ILEpointer *pointer = nullptr;
+    bool resolved = false;
+  };
+
+public:
+  static PGMObjectCache &instance() {
+    static PGMObjectCache cache;
+    return cache;
+  }
+
+  /**
+   * Resolve the program if needed. The pointer returned stays valid for the
+   * life of the process. If it can't be resolved, this throws, and the next
+   * call tries again. When instrumented, the time spent resolving (not
+   * finding it in the cache) is counted for stats_site.
+   */
+  const ILEpointer *resolve(const std::string &library,
+                            const std::string &object,
+                            size_t stats_site = (size_t)-1) {
+    Program *program;
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      auto &entry = this->programs[library + '/' + object];
+      if (!entry) {
+        entry.reset(new Program());
+      }
+      program = entry.get();
+    }
+    std::lock_guard<std::mutex> lock(program->mutex);
+    if (program->resolved) {
+      return program->pointer;
+    }
+#if defined(PASE_CPP_INSTRUMENT)
+    uint64_t begin = CallStatsRegistry::now();
+#else
+    (void)stats_site;
+#endif
+    if (program->pointer == nullptr) {
+      program->pointer = allocate_ile_pointer();
+    }
+    if (_RSLOBJ2(program->pointer, RSLOBJ_TS_PGM, object.c_str(),
+                 library.c_str())) {
+      throw std::invalid_argument("invalid program");
+    }
+#if defined(PASE_CPP_INSTRUMENT)
+    CallStatsRegistry::record_activation(stats_site,
+                                         CallStatsRegistry::now() - begin);
+#endif
+    program->resolved = true;
+    return program->pointer;
+  }
+
+private:
+  PGMObjectCache() {
+    pthread_atfork([]() { instance().lock_all(); },
+                   []() { instance().unlock_all(); },
+                   []() { instance().unlock_all(); });
+  }
+
+  void lock_all() {
+    this->mutex.lock();
+    for (auto &entry : this->programs) {
+      entry.second->mutex.lock();
+    }
+  }
+
+  void unlock_all() {
+    for (auto &entry : this->programs) {
+      entry.second->mutex.unlock();
+    }
+    this->mutex.unlock();
+  }
+
+  std::mutex mutex;
+  std::unordered_map<std::string, std::unique_ptr<Program>> programs;
+};
+
+/**
+ * A program resolved on first use through PGMObjectCache, and calls to it
+ * (with instrumentation); shared by PGMFunction and PGMDirectFunction.
+ */
+class PGMObject {
+public:
+  PGMObject(const char *library, const char *object) {
+    this->pgm = nullptr;
+    this->library = library;
+    this->object = object;
+#if defined(PASE_CPP_INSTRUMENT)
+    this->stats_site =
+        CallStatsRegistry::instance().site(this->library + "/" + this->object);
+#endif
+  }
+
+  const ILEpointer *init() {
+    const ILEpointer *pgm = __atomic_load_n(&this->pgm, __ATOMIC_ACQUIRE);
+    if (pgm != nullptr) {
+      return pgm;
+    }
+#if defined(PASE_CPP_INSTRUMENT)
+    pgm = PGMObjectCache::instance().resolve(this->library, this->object,
+                                             this->stats_site);
+#else
+    pgm = PGMObjectCache::instance().resolve(this->library, this->object);
+#endif
+    __atomic_store_n(&this->pgm, pgm, __ATOMIC_RELEASE);
+    return pgm;
+  }
+
+  int call(const ILEpointer *pgm, void **pgm_argv, int flags) {
+#if defined(PASE_CPP_INSTRUMENT)
+    uint64_t begin = CallStatsRegistry::now();
+#endif
+    int rc = _PGMCALL(pgm, pgm_argv, flags);
+#if defined(PASE_CPP_INSTRUMENT)
+    CallStatsRegistry::record_call(
+        this->stats_site, CallStatsRegistry::now() - begin,
+        rc == 0 ? CallResult::ok
+                : rc == -1 ? CallResult::exception : CallResult::other);
+#endif
+    return rc;
+  }
+
+private:
+  // Owned by PGMObjectCache
+  const ILEpointer *pgm;
+  std::string library, object;
+#if defined(PASE_CPP_INSTRUMENT)
+  size_t stats_site;
+#endif
+};
+
 template <typename... TArgs> class PGMFunction {
 public:
-  PGMFunction(const char *library, const char *object, int flags = 0) {
+  /**
+   * The program isn't resolved until the first call (or init), so wrappers
+   * can be declared as globals without resolving programs that aren't used.
+   * An invalid program throws then, not here.
+   */
+  PGMFunction(const char *library, const char *object, int flags = 0)
+      : program(library, object) {
     static_assert(sizeof...(TArgs) <= 16383,
                   "_PGMCALL maximum arguments reached");
 
     this->flags = process_flags(flags);
-    // Unlike ILE handles, these survive forks
-    if (_RSLOBJ2(&this->pgm, RSLOBJ_TS_PGM, object, library)) {
-      throw std::invalid_argument("invalid program");
-    }
   }
+
+  const ILEpointer *init() { return this->program.init(); }
+
   int operator()(TArgs... args) {
     void *pgm_argv[] = {ParameterArrayMember(args)..., NULL};
-    return _PGMCALL(&this->pgm, pgm_argv, this->flags);
+    return this->program.call(this->init(), pgm_argv, this->flags);
+  }
+
+  int operator()(PGMCallFlags flags, TArgs... args) {
+    void *pgm_argv[] = {ParameterArrayMember(args)..., NULL};
+    return this->program.call(this->init(), pgm_argv,
+                              process_flags(flags.flags));
+  }
+
+  /**
+   * Call the program once for each of count argument tuples, reusing one
+   * argv. Value types are passed by reference to their place in the tuple,
+   * so the program can write to them, like output parameters. The _PGMCALL
+   * return code of each call is stored in status, if it isn't null.
+   * Returns the number of calls that didn't return 0.
+   *
+   * Batches always call with PGMCALL_EXCP_NOSIGNAL, so an MI exception is
+   * stored as -1 for that call, instead of signalling partway through.
+   */
+  size_t call_batch(std::tuple<TArgs...> *args, size_t count,
+                    int *status = nullptr) {
+    void *pgm_argv[sizeof...(TArgs) + 1] = {};
+    const ILEpointer *pgm = this->init();
+    const int flags = this->flags | PGMCALL_EXCP_NOSIGNAL;
+    size_t failed = 0;
+    for (size_t i = 0; i < count; i++) {
+      fill_argv(pgm_argv, args[i], std::index_sequence_for<TArgs...>());
+      int rc = this->program.call(pgm, pgm_argv, flags);
+      if (rc != 0) {
+        failed++;
+      }
+      if (status != nullptr) {
+        status[i] = rc;
+      }
+    }
+    return failed;
   }
 
 private:
+  template <size_t... indices>
+  static void fill_argv(void **pgm_argv, std::tuple<TArgs...> &args,
+                        std::index_sequence<indices...>) {
+    (void)std::initializer_list<int>{
+        (pgm_argv[indices] = ParameterArrayMember(std::get<indices>(args)),
+         0)...};
+  }
+
   constexpr int process_flags(int flags) {
     if (sizeof...(TArgs) > PGMCALL_MAXARGS) {
       flags |= PGMCALL_NOMAXARGS;
@@ -83,14 +298,147 @@ private:
       throw std::invalid_argument(
           "all values must be const char* for ASCII strings flag");
     }
-    // XXX: PGMCALL_DIRECT_ARGS requires different argv type
+    // PGMCALL_DIRECT_ARGS requires a different argv; see PGMDirectFunction
     return flags &
            (PGMCALL_DROP_ADOPT | PGMCALL_NOINTERRUPT | PGMCALL_NOMAXARGS |
             PGMCALL_ASCII_STRINGS | PGMCALL_EXCP_NOSIGNAL);
   }
 
-  ILEpointer pgm __attribute__((aligned(16)));
+  PGMObject program;
   int flags;
 };
 
+/**
+ * The argv for a PGMDirectFunction: tagged space pointers to the arguments
+ * (set with _SETSPP), and the storage they point to. Value arguments are
+ * copied into that storage, so their pointers are set once, here; pointer
+ * arguments only need theirs set again when the address changes. The
+ * pointers refer to this frame, so it can't be copied.
+ */
+template <typename... TArgs> class PGMDirectFrame {
+public:
+  PGMDirectFrame() : argv(), values(), targets() {
+    this->point_all(std::index_sequence_for<TArgs...>());
+  }
+  PGMDirectFrame(const PGMDirectFrame &) = delete;
+  PGMDirectFrame &operator=(const PGMDirectFrame &) = delete;
+
+  void set(TArgs &... args) {
+    this->set_all(std::index_sequence_for<TArgs...>(), args...);
+  }
+
+  // Null terminated, as _PGMCALL expects; the last pointer is never set
+  void **data() { return (void **)this->argv; }
+
+private:
+  template <size_t index>
+  using Argument = std::tuple_element_t<index, std::tuple<TArgs...>>;
+
+  template <size_t... indices> void point_all(std::index_sequence<indices...>) {
+    (void)std::initializer_list<int>{(this->point<indices>(), 0)...};
+  }
+
+  template <size_t... indices>
+  void set_all(std::index_sequence<indices...>, TArgs &... args) {
+    (void)std::initializer_list<int>{
+        (std::get<indices>(this->values) = args,
+         this->repoint<indices>(std::is_pointer<Argument<indices>>()), 0)...};
+  }
+
+  template <size_t index> void point() {
+    this->targets[index] = ParameterArrayMember(std::get<index>(this->values));
+    _SETSPP(&this->argv[index], this->targets[index]);
+  }
+
+  // Values stay where they are
+  template <size_t index> void repoint(std::false_type) {}
+  template <size_t index> void repoint(std::true_type) {
+    if (ParameterArrayMember(std::get<index>(this->values)) !=
+        this->targets[index]) {
+      this->point<index>();
+    }
+  }
+
+  ILEpointer argv[sizeof...(TArgs) + 1] __attribute__((aligned(16)));
+  std::tuple<TArgs...> values;
+  // What each pointer in argv was last set to
+  std::array<void *, sizeof...(TArgs)> targets;
+};
+
+/**
+ * Like PGMFunction, but calls with PGMCALL_DIRECT_ARGS: argv is an array of
+ * tagged space pointers to the arguments, instead of PASE addresses for
+ * _PGMCALL to convert on every call. The program sees the same thing; the
+ * difference is in who builds the pointers, and how often. Each thread has
+ * a PGMDirectFrame for the wrapper's argument types, so a call only copies
+ * the arguments into it. Since nothing is converted, PGMCALL_ASCII_STRINGS
+ * can't be used.
+ *
+ * The program reads and writes arguments as raw storage, so they must be
+ * trivially copyable; pass anything else by pointer.
+ */
+template <typename... TArgs> class PGMDirectFunction {
+  static_assert(Conjunction<std::is_trivially_copyable<TArgs>...>::value,
+                "direct arguments must be trivially copyable");
+  static_assert(sizeof...(TArgs) <= 16383,
+                "_PGMCALL maximum arguments reached");
+
+public:
+  PGMDirectFunction(const char *library, const char *object, int flags = 0)
+      : program(library, object) {
+    this->flags = process_flags(flags);
+  }
+
+  const ILEpointer *init() { return this->program.init(); }
+
+  int operator()(TArgs... args) {
+    return this->call(this->flags, args...);
+  }
+
+  int operator()(PGMCallFlags flags, TArgs... args) {
+    return this->call(process_flags(flags.flags), args...);
+  }
+
+private:
+  int call(int flags, TArgs &... args) {
+    static thread_local PGMDirectFrame<TArgs...> frame;
+    frame.set(args...);
+    return this->program.call(this->init(), frame.data(), flags);
+  }
+
+  constexpr int process_flags(int flags) {
+    if (sizeof...(TArgs) > PGMCALL_MAXARGS) {
+      flags |= PGMCALL_NOMAXARGS;
+    }
+    if (flags & PGMCALL_ASCII_STRINGS) {
+      throw std::invalid_argument(
+          "ASCII strings flag can't be used with direct arguments");
+    }
+    return PGMCALL_DIRECT_ARGS |
+           (flags & (PGMCALL_DROP_ADOPT | PGMCALL_NOINTERRUPT |
+                     PGMCALL_NOMAXARGS | PGMCALL_EXCP_NOSIGNAL));
+  }
+
+  PGMObject program;
+  int flags;
+};
+
+} // inline namespace PASE_CPP_ABI
+
+/**
+ * Resolve several wrappers at once, each on its own thread, i.e. at startup
+ * instead of on each one's first call. Works with anything that has init(),
+ * like ILEFunction. If any fail, the first failure is rethrown once all of
+ * them are done.
+ */
+template <typename... TFunctions> void prewarm(TFunctions &... functions) {
+  std::array<std::future<void>, sizeof...(TFunctions)> pending = {
+      {std::async(std::launch::async,
+                  [&functions]() { functions.init(); })...}};
+  // Waiting on the rest is done by their destructors if one throws
+  for (auto &resolved : pending) {
+    resolved.get();
+  }
+}
+
 } // namespace pase_cpp
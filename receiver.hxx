@@ -0,0 +1,200 @@
+// vim: expandtab:ts=2:sw=2
+/*
+ * Copyright (c) 2025 Seiden Group
+ *
+ * SPDX-License-Identifier: ISC
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace pase_cpp {
+
+/*
+ * Receiver buffers for retrieve APIs, which start with the usual "bytes
+ * returned" and "bytes available" fields. Instead of guessing a fixed size
+ * (and wasting stack, or silently truncating), retrieve calls the API with
+ * a buffer from a pool and, if the output didn't fit, calls it once more
+ * with a buffer as big as it said it needed.
+ *
+ * Buffers come from a per-thread pool of power-of-two size classes, so
+ * repeated calls reuse buffers instead of allocating. They're 16-byte
+ * aligned, in case the output contains pointers.
+ */
+
+/**
+ * The header at the start of most retrieve API receivers.
+ */
+struct ReceiverHeader {
+  int bytes_returned;
+  int bytes_available;
+};
+
+class ReceiverPool {
+  // 256 bytes to 16 MB; anything bigger isn't pooled
+  static constexpr size_t min_class = 8;
+  static constexpr size_t max_class = 24;
+  // Kept per class; any more are freed when released
+  static constexpr size_t max_free = 4;
+
+public:
+  ReceiverPool() = default;
+  ReceiverPool(const ReceiverPool &) = delete;
+  ReceiverPool &operator=(const ReceiverPool &) = delete;
+
+  ~ReceiverPool() {
+    for (auto &buffers : this->free) {
+      for (char *buffer : buffers) {
+        std::free(buffer);
+      }
+    }
+  }
+
+  /**
+   * This thread's pool.
+   */
+  static ReceiverPool &local() {
+    static thread_local ReceiverPool pool;
+    return pool;
+  }
+
+  /**
+   * Get a buffer of at least size bytes; size is rounded up to the size
+   * actually allocated.
+   */
+  char *acquire(size_t &size) {
+    size_t size_class = class_of(size);
+    if (size_class <= max_class) {
+      size = (size_t)1 << size_class;
+      auto &buffers = this->free[size_class - min_class];
+      if (!buffers.empty()) {
+        char *buffer = buffers.back();
+        buffers.pop_back();
+        return buffer;
+      }
+    }
+    void *buffer = nullptr;
+    if (posix_memalign(&buffer, 16, size) != 0) {
+      throw std::bad_alloc();
+    }
+    return (char *)buffer;
+  }
+
+  /**
+   * Return a buffer from acquire, with the size it was given.
+   */
+  void release(char *buffer, size_t size) {
+    size_t size_class = class_of(size);
+    if (size_class <= max_class && ((size_t)1 << size_class) == size) {
+      auto &buffers = this->free[size_class - min_class];
+      if (buffers.size() < max_free) {
+        if (buffers.capacity() < max_free) {
+          buffers.reserve(max_free);
+        }
+        buffers.push_back(buffer);
+        return;
+      }
+    }
+    std::free(buffer);
+  }
+
+private:
+  static size_t class_of(size_t size) {
+    size_t size_class = min_class;
+    while (size_class <= max_class && ((size_t)1 << size_class) < size) {
+      size_class++;
+    }
+    return size_class;
+  }
+
+  std::array<std::vector<char *>, max_class - min_class + 1> free;
+};
+
+/**
+ * A receiver buffer from this thread's pool, returned to the pool of the
+ * thread that destroys it.
+ */
+class Receiver {
+public:
+  explicit Receiver(size_t size) : buffer_size(size) {
+    if (size < sizeof(ReceiverHeader)) {
+      this->buffer_size = sizeof(ReceiverHeader);
+    }
+    this->buffer = ReceiverPool::local().acquire(this->buffer_size);
+    // In case the call fails without writing it
+    memset(this->buffer, 0, sizeof(ReceiverHeader));
+  }
+
+  Receiver(Receiver &&other)
+      : buffer(other.buffer), buffer_size(other.buffer_size) {
+    other.buffer = nullptr;
+  }
+
+  Receiver &operator=(Receiver &&other) {
+    std::swap(this->buffer, other.buffer);
+    std::swap(this->buffer_size, other.buffer_size);
+    return *this;
+  }
+
+  Receiver(const Receiver &) = delete;
+  Receiver &operator=(const Receiver &) = delete;
+
+  ~Receiver() {
+    if (this->buffer != nullptr) {
+      ReceiverPool::local().release(this->buffer, this->buffer_size);
+    }
+  }
+
+  char *data() { return this->buffer; }
+  const char *data() const { return this->buffer; }
+  size_t size() const { return this->buffer_size; }
+
+  /**
+   * The size to pass to the API; the int it expects.
+   */
+  int length() const {
+    return this->buffer_size > 0x7FFFFFFF ? 0x7FFFFFFF : (int)this->buffer_size;
+  }
+
+  const ReceiverHeader &header() const {
+    return *(const ReceiverHeader *)this->buffer;
+  }
+
+  /**
+   * If the API had more to return than fit.
+   */
+  bool truncated() const {
+    return this->header().bytes_available > this->header().bytes_returned;
+  }
+
+private:
+  char *buffer;
+  size_t buffer_size;
+};
+
+/**
+ * Call a retrieve API through call(char *receiver, int length), i.e. a
+ * lambda calling a PGMFunction or ILEFunction, with a receiver of at least
+ * size bytes. If the output is truncated, call it again once with a
+ * receiver as big as bytes available. Check the API's error code as usual;
+ * the receiver is returned either way.
+ */
+template <typename TCall> Receiver retrieve(TCall call, size_t size = 4096) {
+  Receiver receiver(size);
+  call(receiver.data(), receiver.length());
+  if (receiver.truncated() &&
+      (size_t)receiver.header().bytes_available > receiver.size()) {
+    receiver = Receiver(receiver.header().bytes_available);
+    call(receiver.data(), receiver.length());
+  }
+  return receiver;
+}
+
+} // namespace pase_cpp
@@ -0,0 +1,221 @@
+// vim: expandtab:ts=2:sw=2
+/*
+ * Copyright (c) 2025 Seiden Group
+ *
+ * SPDX-License-Identifier: ISC
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+#include "ebcdic.hxx"
+
+namespace pase_cpp {
+
+/*
+ * Views over the receiver buffers of IBM i retrieve and list APIs, which
+ * return variable-length data: a header, then entries found through a table
+ * of offsets or at a fixed stride, each possibly followed by variable-length
+ * data. The views read the buffer in place, checking every offset and
+ * length against the size of the buffer; anything out of bounds (i.e. from
+ * a receiver that was too small) throws std::out_of_range instead of
+ * reading past the end.
+ *
+ * The layouts are the API's own structures (i.e. from the system headers);
+ * as with casting the buffer, they must match the API's packing.
+ */
+
+/**
+ * A bounds-checked view of one record of type T in a buffer.
+ */
+template <typename T> class RecordView {
+public:
+  RecordView(const char *buffer, size_t size, size_t offset)
+      : buffer(buffer), size(size), offset(offset) {
+    if (offset > size || size - offset < sizeof(T)) {
+      throw std::out_of_range("record past end of buffer");
+    }
+  }
+
+  const T *operator->() const {
+    return (const T *)(this->buffer + this->offset);
+  }
+  const T &operator*() const { return *this->operator->(); }
+
+  /**
+   * Variable-length data in the record, at offset from the start of the
+   * record (i.e. offsetof of a flexible array member).
+   */
+  const char *bytes(size_t at, size_t length) const {
+    const size_t start = this->offset + at;
+    if (start < this->offset || start > this->size ||
+        this->size - start < length) {
+      throw std::out_of_range("data past end of buffer");
+    }
+    return this->buffer + start;
+  }
+
+  /**
+   * Variable-length EBCDIC text in the record, converted only when used.
+   */
+  EbcdicView ebcdic(size_t at, size_t length) const {
+    return EbcdicView(this->bytes(at, length), length);
+  }
+
+  /**
+   * A fixed-width EBCDIC field of the record, i.e. ebcdic(&T::Name).
+   */
+  template <size_t Len> EbcdicView ebcdic(char (T::*field)[Len]) const {
+    return EbcdicView((**this).*field, Len);
+  }
+
+private:
+  const char *buffer;
+  size_t size;
+  size_t offset;
+};
+
+/*
+ * Iterates a container of records by index; the container knows where each
+ * record starts.
+ */
+template <typename TContainer, typename TEntry> class RecordIterator {
+public:
+  using iterator_category = std::input_iterator_tag;
+  using value_type = RecordView<TEntry>;
+  using difference_type = std::ptrdiff_t;
+  using pointer = void;
+  using reference = RecordView<TEntry>;
+
+  RecordIterator(const TContainer *container, size_t index)
+      : container(container), index(index) {}
+
+  RecordView<TEntry> operator*() const { return (*container)[index]; }
+  RecordIterator &operator++() {
+    this->index++;
+    return *this;
+  }
+  RecordIterator operator++(int) {
+    RecordIterator old = *this;
+    this->index++;
+    return old;
+  }
+  bool operator==(const RecordIterator &other) const {
+    return this->index == other.index;
+  }
+  bool operator!=(const RecordIterator &other) const {
+    return this->index != other.index;
+  }
+
+private:
+  const TContainer *container;
+  size_t index;
+};
+
+/**
+ * Entries found through a table of offsets in the header; i.e. QWCRSVAL's
+ * receiver, where the header has the number of entries at count_offset
+ * and an array of 4-byte offsets at table_offset. Offsets are from the
+ * start of the buffer.
+ *
+ *   using SysvalTable = OffsetTableView<Qwc_Rsval_Data_Rtnd_t,
+ *       Qwc_Rsval_Sys_Value_Table_t,
+ *       offsetof(Qwc_Rsval_Data_Rtnd_t, Number_Sys_Vals_Rtnd),
+ *       offsetof(Qwc_Rsval_Data_Rtnd_t, Offset_Sys_Val_Table)>;
+ */
+template <typename THeader, typename TEntry, size_t count_offset,
+          size_t table_offset>
+class OffsetTableView {
+  using Self = OffsetTableView<THeader, TEntry, count_offset, table_offset>;
+
+public:
+  using iterator = RecordIterator<Self, TEntry>;
+
+  OffsetTableView(const void *buffer, size_t size)
+      : buffer((const char *)buffer), size(size) {
+    this->entries = read_int(count_offset);
+    if (this->entries < 0 || table_offset > size ||
+        (size - table_offset) / sizeof(int) < (size_t)this->entries) {
+      throw std::out_of_range("offset table past end of buffer");
+    }
+  }
+
+  RecordView<THeader> header() const {
+    return RecordView<THeader>(this->buffer, this->size, 0);
+  }
+
+  size_t count() const { return this->entries; }
+
+  RecordView<TEntry> operator[](size_t index) const {
+    if (index >= (size_t)this->entries) {
+      throw std::out_of_range("index past end of entries");
+    }
+    int offset = read_int(table_offset + index * sizeof(int));
+    if (offset < 0) {
+      throw std::out_of_range("negative offset");
+    }
+    return RecordView<TEntry>(this->buffer, this->size, offset);
+  }
+
+  iterator begin() const { return iterator(this, 0); }
+  iterator end() const { return iterator(this, this->entries); }
+
+private:
+  int read_int(size_t offset) const {
+    if (offset > this->size || this->size - offset < sizeof(int)) {
+      throw std::out_of_range("header past end of buffer");
+    }
+    int value;
+    memcpy(&value, this->buffer + offset, sizeof(value));
+    return value;
+  }
+
+  const char *buffer;
+  size_t size;
+  int entries;
+};
+
+/**
+ * Entries at a fixed stride, like in list APIs, where the header says
+ * where the first entry is, how many there are, and how long each one is.
+ * The stride can be longer than TEntry, for newer formats with more fields.
+ */
+template <typename TEntry> class StrideView {
+public:
+  using iterator = RecordIterator<StrideView<TEntry>, TEntry>;
+
+  StrideView(const void *buffer, size_t size, size_t offset, size_t count,
+             size_t stride)
+      : buffer((const char *)buffer), size(size), offset(offset),
+        entries(count), stride(stride) {
+    if (stride < sizeof(TEntry)) {
+      throw std::invalid_argument("entries shorter than the entry type");
+    }
+    if (count > 0 && (offset > size || (size - offset) / stride < count)) {
+      throw std::out_of_range("entries past end of buffer");
+    }
+  }
+
+  size_t count() const { return this->entries; }
+
+  RecordView<TEntry> operator[](size_t index) const {
+    if (index >= this->entries) {
+      throw std::out_of_range("index past end of entries");
+    }
+    return RecordView<TEntry>(this->buffer, this->size,
+                              this->offset + index * this->stride);
+  }
+
+  iterator begin() const { return iterator(this, 0); }
+  iterator end() const { return iterator(this, this->entries); }
+
+private:
+  const char *buffer;
+  size_t size, offset, entries, stride;
+};
+
+} // namespace pase_cpp
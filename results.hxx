@@ -0,0 +1,220 @@
+// vim: expandtab:ts=2:sw=2
+/*
+ * Copyright (c) 2025 Seiden Group
+ *
+ * SPDX-License-Identifier: ISC
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace pase_cpp {
+
+/*
+ * Storage for structures returned by ILE procedures. _ILECALLX writes an
+ * aggregate return through r_aggregate, and because it can contain tagged
+ * pointers, it can't be copied anywhere else afterwards. Instead of making
+ * the caller provide that storage, a call can return a handle to a slot in
+ * a per-thread arena, where the structure was written and stays until the
+ * handle is destroyed. Moving the handle doesn't move the structure.
+ *
+ * Slots are 16-byte aligned, and are carved out of chunks in order, so the
+ * results of a batch of calls are contiguous. A chunk is freed (or reused
+ * by its arena) once all its slots are released, from whichever thread.
+ */
+
+struct ResultChunk {
+  // Slots not yet released, plus one while the arena is still carving
+  // slots out of this chunk
+  std::atomic<size_t> live;
+  size_t size;
+};
+
+class ResultArena {
+  static constexpr size_t chunk_size = 64 * 1024;
+  static constexpr size_t header_size = (sizeof(ResultChunk) + 15) & ~15;
+
+public:
+  ResultArena() : current(nullptr), used(0) {}
+  ResultArena(const ResultArena &) = delete;
+  ResultArena &operator=(const ResultArena &) = delete;
+
+  // Slots still held elsewhere keep their chunk alive
+  ~ResultArena() {
+    if (this->current != nullptr) {
+      release(this->current);
+    }
+  }
+
+  /**
+   * This thread's arena.
+   */
+  static ResultArena &local() {
+    static thread_local ResultArena arena;
+    return arena;
+  }
+
+  /**
+   * Get a 16-byte aligned slot of at least size (> 0) bytes; the chunk it's
+   * in is returned in chunk, to release it with.
+   */
+  void *acquire(size_t size, ResultChunk **chunk) {
+    size = (size + 15) & ~(size_t)15;
+    if (size > chunk_size - header_size) {
+      // Too big to share a chunk
+      *chunk = allocate(header_size + size, 1);
+      return (char *)*chunk + header_size;
+    }
+    if (this->current == nullptr ||
+        this->current->size - this->used < size) {
+      if (this->current != nullptr &&
+          this->current->live.load(std::memory_order_acquire) == 1) {
+        // Every slot was released; start over in the same chunk
+        this->used = header_size;
+      } else {
+        if (this->current != nullptr) {
+          release(this->current);
+        }
+        this->current = allocate(chunk_size, 1);
+        this->used = header_size;
+      }
+    }
+    this->current->live.fetch_add(1, std::memory_order_relaxed);
+    void *slot = (char *)this->current + this->used;
+    this->used += size;
+    *chunk = this->current;
+    return slot;
+  }
+
+  /**
+   * Release a slot from acquire, from any thread.
+   */
+  static void release(ResultChunk *chunk) {
+    if (chunk->live.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      chunk->~ResultChunk();
+      std::free(chunk);
+    }
+  }
+
+private:
+  static ResultChunk *allocate(size_t size, size_t live) {
+    void *p = nullptr;
+    if (posix_memalign(&p, 16, size) != 0) {
+      throw std::bad_alloc();
+    }
+    ResultChunk *chunk = new (p) ResultChunk();
+    chunk->live.store(live, std::memory_order_relaxed);
+    chunk->size = size;
+    return chunk;
+  }
+
+  ResultChunk *current;
+  size_t used;
+};
+
+/*
+ * Owns slots from this thread's arena; ILEResult and ILEResults add the
+ * typed accessors.
+ */
+class ResultSlots {
+public:
+  ResultSlots(ResultSlots &&other) : slots(other.slots), chunk(other.chunk) {
+    other.slots = nullptr;
+    other.chunk = nullptr;
+  }
+
+  ResultSlots &operator=(ResultSlots &&other) {
+    std::swap(this->slots, other.slots);
+    std::swap(this->chunk, other.chunk);
+    return *this;
+  }
+
+  ResultSlots(const ResultSlots &) = delete;
+  ResultSlots &operator=(const ResultSlots &) = delete;
+
+  ~ResultSlots() {
+    if (this->chunk != nullptr) {
+      ResultArena::release(this->chunk);
+    }
+  }
+
+protected:
+  ResultSlots() : slots(nullptr), chunk(nullptr) {}
+
+  explicit ResultSlots(size_t size) : slots(nullptr), chunk(nullptr) {
+    if (size > 0) {
+      this->slots = ResultArena::local().acquire(size, &this->chunk);
+    }
+  }
+
+  void *slots;
+  ResultChunk *chunk;
+};
+
+/**
+ * A structure returned by an ILE procedure, in the slot it was written to.
+ */
+template <typename T> class ILEResult : public ResultSlots {
+  static_assert(std::is_trivially_destructible<T>::value,
+                "results must be plain structures");
+  static_assert(alignof(T) <= 16, "results are only 16-byte aligned");
+
+public:
+  ILEResult() : ResultSlots(sizeof(T)) { new (this->slots) T; }
+
+  T *get() { return (T *)this->slots; }
+  const T *get() const { return (const T *)this->slots; }
+  T &operator*() { return *this->get(); }
+  const T &operator*() const { return *this->get(); }
+  T *operator->() { return this->get(); }
+  const T *operator->() const { return this->get(); }
+};
+
+/**
+ * Structures returned by a batch of calls, contiguous in one allocation.
+ */
+template <typename T> class ILEResults : public ResultSlots {
+  static_assert(std::is_trivially_destructible<T>::value,
+                "results must be plain structures");
+  static_assert(alignof(T) <= 16, "results are only 16-byte aligned");
+
+public:
+  explicit ILEResults(size_t count = 0)
+      : ResultSlots(sizeof(T) * count), results(count) {
+    for (size_t i = 0; i < count; i++) {
+      new (this->data() + i) T;
+    }
+  }
+
+  ILEResults(ILEResults &&other)
+      : ResultSlots(std::move(other)), results(other.results) {
+    other.results = 0;
+  }
+
+  ILEResults &operator=(ILEResults &&other) {
+    ResultSlots::operator=(std::move(other));
+    std::swap(this->results, other.results);
+    return *this;
+  }
+
+  size_t size() const { return this->results; }
+  T *data() { return (T *)this->slots; }
+  const T *data() const { return (const T *)this->slots; }
+  T &operator[](size_t index) { return this->data()[index]; }
+  const T &operator[](size_t index) const { return this->data()[index]; }
+  T *begin() { return this->data(); }
+  T *end() { return this->data() + this->results; }
+  const T *begin() const { return this->data(); }
+  const T *end() const { return this->data() + this->results; }
+
+private:
+  size_t results;
+};
+
+} // namespace pase_cpp
@@ -0,0 +1,264 @@
+/* vim: expandtab:ts=2:sw=2 */
+/*
+ * Copyright (c) 2025 Seiden Group
+ *
+ * SPDX-License-Identifier: ISC
+ */
+
+/*
+ * In-process stand-in for PASE's as400_protos.h, so the wrappers can be
+ * built and benchmarked on Linux. Only what the wrappers use is declared;
+ * the layouts match PASE, but constant values are only self-consistent.
+ *
+ * "Service programs" and "programs" are registered up front with C
+ * functions implementing them; calls through the wrappers end up in those.
+ * Every entry point counts how many times it was called, in stub_counters.
+ *
+ * Like the real header, this is meant to be included in extern "C".
+ */
+
+#pragma once
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef uint64_t address64_t;
+
+typedef union _ILEpointer {
+  long double quadword;
+  struct {
+    char filler[16 - sizeof(address64_t)];
+    address64_t addr;
+  } s;
+} __attribute__((aligned(16))) ILEpointer;
+
+typedef struct {
+  ILEpointer descriptor;
+  union {
+    ILEpointer r_aggregate;
+    struct {
+      char filler[7];
+      int8_t r_int8;
+    } s_int8;
+    struct {
+      char filler[7];
+      uint8_t r_uint8;
+    } s_uint8;
+    struct {
+      char filler[6];
+      int16_t r_int16;
+    } s_int16;
+    struct {
+      char filler[6];
+      uint16_t r_uint16;
+    } s_uint16;
+    struct {
+      char filler[4];
+      int32_t r_int32;
+    } s_int32;
+    struct {
+      char filler[4];
+      uint32_t r_uint32;
+    } s_uint32;
+    int64_t r_int64;
+    uint64_t r_uint64;
+    double r_float64;
+  } result;
+} __attribute__((aligned(16))) ILEarglist_base;
+
+typedef int16_t arg_type_t;
+typedef int16_t result_type_t;
+
+#define ARG_END 0
+#define ARG_INT8 (-1)
+#define ARG_UINT8 (-2)
+#define ARG_INT16 (-3)
+#define ARG_UINT16 (-4)
+#define ARG_INT32 (-5)
+#define ARG_UINT32 (-6)
+#define ARG_INT64 (-7)
+#define ARG_UINT64 (-8)
+#define ARG_FLOAT32 (-9)
+#define ARG_FLOAT64 (-10)
+#define ARG_MEMPTR (-11)
+
+#define RESULT_VOID 0
+#define RESULT_INT8 (-1)
+#define RESULT_UINT8 (-2)
+#define RESULT_INT16 (-3)
+#define RESULT_UINT16 (-4)
+#define RESULT_INT32 (-5)
+#define RESULT_UINT32 (-6)
+#define RESULT_INT64 (-7)
+#define RESULT_UINT64 (-8)
+#define RESULT_FLOAT64 (-10)
+
+#define ILELOAD_LIBOBJ 0x00000001
+#define ILESYM_PROCEDURE 1
+
+#define ILECALL_NOINTERRUPT 0x00000004
+#define ILECALL_EXCP_NOSIGNAL 0x00000020
+#define ILECALL_INVALID_ARG 1
+#define ILECALL_INVALID_RESULT 2
+#define ILECALL_INVALID_FLAGS 3
+
+#define RSLOBJ_TS_PGM 0x0201
+
+#define PGMCALL_DIRECT_ARGS 0x00000001
+#define PGMCALL_DROP_ADOPT 0x00000002
+#define PGMCALL_NOINTERRUPT 0x00000004
+#define PGMCALL_NOMAXARGS 0x00000008
+#define PGMCALL_ASCII_STRINGS 0x00000010
+#define PGMCALL_EXCP_NOSIGNAL 0x00000020
+#define PGMCALL_MAXARGS 255
+
+/* errno for an MI exception, when it doesn't signal */
+#define STUB_EXCP_ERRNO 3474
+
+/*
+ * An ILE procedure gets the arglist; arguments follow the base at the next
+ * 16-byte boundary. Return 0, or -1 with errno set for an MI exception.
+ */
+typedef int (*stub_ile_procedure)(ILEarglist_base *arglist,
+                                  const arg_type_t *signature,
+                                  result_type_t result_type);
+/* A program gets the argv _PGMCALL was given; return like the above. */
+typedef int (*stub_program)(void **argv, unsigned flags);
+
+struct stub_counters {
+  unsigned long load, sym, call, rslobj, pgmcall;
+};
+
+#define STUB_MAX_ENTRIES 256
+
+struct stub_entry {
+  char path[64], symbol[64];
+  stub_ile_procedure procedure;
+  stub_program program;
+};
+
+struct stub_state {
+  struct stub_counters counters;
+  struct stub_entry entries[STUB_MAX_ENTRIES];
+  int count;
+};
+
+inline struct stub_state *stub_state(void) {
+  static struct stub_state state;
+  return &state;
+}
+
+inline struct stub_counters *stub_counters(void) {
+  return &stub_state()->counters;
+}
+
+inline void stub_count(unsigned long *counter) {
+  __atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
+}
+
+/* Not thread-safe; register everything before making calls. */
+inline void stub_register_procedure(const char *path, const char *symbol,
+                                    stub_ile_procedure procedure) {
+  struct stub_entry *e = &stub_state()->entries[stub_state()->count++];
+  strncpy(e->path, path, sizeof(e->path) - 1);
+  strncpy(e->symbol, symbol, sizeof(e->symbol) - 1);
+  e->procedure = procedure;
+}
+
+inline void stub_register_program(const char *library, const char *object,
+                                  stub_program program) {
+  struct stub_entry *e = &stub_state()->entries[stub_state()->count++];
+  strncpy(e->path, library, sizeof(e->path) - 1);
+  strncpy(e->symbol, object, sizeof(e->symbol) - 1);
+  e->program = program;
+}
+
+/* Activation marks are the index of the first entry with the path, + 1 */
+inline unsigned long long _ILELOADX(const void *id, unsigned int flags) {
+  (void)flags;
+  stub_count(&stub_counters()->load);
+  for (int i = 0; i < stub_state()->count; i++) {
+    if (stub_state()->entries[i].procedure &&
+        strcmp(stub_state()->entries[i].path, (const char *)id) == 0) {
+      return i + 1;
+    }
+  }
+  return (unsigned long long)-1;
+}
+
+inline int _ILESYMX(ILEpointer *export_, unsigned long long actmark,
+                    const char *symbol) {
+  stub_count(&stub_counters()->sym);
+  if (actmark == 0 || actmark > (unsigned long long)stub_state()->count) {
+    return -1;
+  }
+  const char *path = stub_state()->entries[actmark - 1].path;
+  for (int i = 0; i < stub_state()->count; i++) {
+    struct stub_entry *e = &stub_state()->entries[i];
+    if (e->procedure && strcmp(e->path, path) == 0 &&
+        strcmp(e->symbol, symbol) == 0) {
+      export_->s.addr = (address64_t)(uintptr_t)e;
+      return ILESYM_PROCEDURE;
+    }
+  }
+  return 0;
+}
+
+inline int _ILECALLX(const ILEpointer *target, ILEarglist_base *ILEarglist,
+                     const arg_type_t *signature, result_type_t result_type,
+                     int flags) {
+  stub_count(&stub_counters()->call);
+  if (flags & ~(ILECALL_NOINTERRUPT | ILECALL_EXCP_NOSIGNAL)) {
+    return ILECALL_INVALID_FLAGS;
+  }
+  struct stub_entry *e = (struct stub_entry *)(uintptr_t)target->s.addr;
+  return e->procedure(ILEarglist, signature, result_type);
+}
+
+inline int _RSLOBJ2(ILEpointer *sysptr, unsigned short type, const char *name,
+                    const char *lib) {
+  stub_count(&stub_counters()->rslobj);
+  if (type != RSLOBJ_TS_PGM) {
+    return -1;
+  }
+  for (int i = 0; i < stub_state()->count; i++) {
+    struct stub_entry *e = &stub_state()->entries[i];
+    if (e->program && strcmp(e->path, lib) == 0 &&
+        strcmp(e->symbol, name) == 0) {
+      sysptr->s.addr = (address64_t)(uintptr_t)e;
+      return 0;
+    }
+  }
+  errno = ENOENT;
+  return -1;
+}
+
+/* Space pointers are just the address, like memory pointers; not counted */
+inline void _SETSPP(ILEpointer *target, const void *source) {
+  memset(target, 0, sizeof(*target));
+  target->s.addr = (address64_t)(uintptr_t)source;
+}
+
+#define STUB_MAX_DIRECT_ARGS 256
+
+inline int _PGMCALL(const ILEpointer *target, void **argv, unsigned flags) {
+  stub_count(&stub_counters()->pgmcall);
+  struct stub_entry *e = (struct stub_entry *)(uintptr_t)target->s.addr;
+  if (flags & PGMCALL_DIRECT_ARGS) {
+    /* Programs get a PASE argv either way */
+    const ILEpointer *pointers = (const ILEpointer *)argv;
+    void *converted[STUB_MAX_DIRECT_ARGS + 1];
+    int i;
+    for (i = 0; pointers[i].s.addr != 0; i++) {
+      if (i == STUB_MAX_DIRECT_ARGS) {
+        errno = E2BIG;
+        return -1;
+      }
+      converted[i] = (void *)(uintptr_t)pointers[i].s.addr;
+    }
+    converted[i] = NULL;
+    return e->program(converted, flags);
+  }
+  return e->program(argv, flags);
+}